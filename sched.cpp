@@ -4,105 +4,610 @@
 #include <cmath>
 #include <vector>
 #include <list>
+#include <set>
 #include <string>
 #include <regex>
 #include <iterator>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <atomic>
+#include <climits>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <random>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#endif
+#include <sstream>
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+// process behaviors written as coroutines need a C++20 build
+#define SCHED_COROUTINES
+#endif
+
+#ifdef SCHED_STATS
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
 
 using namespace std;
 
-// initialise global variables
+// hot path instrumentation: statements wrapped in STATS() are compiled in only when building with -DSCHED_STATS,
+// so the default build pays nothing for them
+#ifdef SCHED_STATS
+#define STATS(statement) statement
+#else
+#define STATS(statement)
+#endif
+
+// initialise global variables: random numbers are loaded once and shared read-only by every simulation
 int num_random_numbers;
-int ofs = 0;
 vector<int> randvals;
-int CURRENT_TIME = 0;
-int num_performing_IO = 0;
-int time_of_IO_start;
-int time_of_IO_end;
-int total_IO_time = 0;
-int max_prio;
+// with -r the random numbers come from a seeded generator instead of the random file
+bool builtin_random = false;
+uint64_t random_seed = 0;
+
+// remainder by a divisor fixed ahead of time, without a division: with M = ceil(2^64/d), the low 64 bits of M*a
+// are the fraction a/d in fixed point, and multiplying that fraction by d gives a % d in the high 64 bits (exact for
+// every 32 bit a and d, see Lemire et al., "Faster remainder by direct computation")
+struct FastModulus {
+    uint64_t multiplier = 0;
+    uint32_t divisor = 0;
+
+    FastModulus() {}
+
+    FastModulus(uint32_t divisor) {
+        this->divisor = divisor;
+        if (divisor > 0) {
+            multiplier = UINT64_MAX/divisor + 1;
+        }
+    }
+
+    uint32_t mod(uint32_t value) const {
+        uint64_t fraction = multiplier*value;
+        return (uint32_t) (((unsigned __int128) fraction*divisor) >> 64);
+    }
+};
+
+// stream of random numbers from the shared list: every simulation reads it from its own offset. In built-in mode
+// the numbers are drawn from a PCG32 generator (O'Neill, pcg-random.org) instead, so no table is stored at all
+struct RandomStream {
+    int ofs = 0;
+    uint64_t state = 0;
+    uint64_t increment = 0;
+
+    RandomStream() {
+        if (builtin_random) {
+            seed(random_seed, 0);
+        }
+    }
+
+    // start generator stream number stream from seed; different streams of a seed are independent
+    void seed(uint64_t seed, uint64_t stream) {
+        state = 0;
+        increment = (stream << 1) | 1;
+        next_generated();
+        state = state + seed;
+        next_generated();
+    }
+
+    uint32_t next_generated() {
+        uint64_t old_state = state;
+        state = old_state*6364136223846793005ULL + increment;
+        uint32_t xorshifted = (uint32_t) (((old_state >> 18) ^ old_state) >> 27);
+        uint32_t rotation = (uint32_t) (old_state >> 59);
+        return (xorshifted >> rotation) | (xorshifted << ((-rotation) & 31));
+    }
+
+    // return next raw random number
+    int next() {
+        if (builtin_random) {
+            // non-negative like the numbers of a random file
+            return (int) (next_generated() >> 1);
+        }
+        int randval = randvals[ofs];
+        ofs++;
+        if (ofs > num_random_numbers-1) {
+            ofs = 0;
+        }
+        return randval;
+    }
+
+    int myrandom(int burst) {
+        // returns number between 1 and burst
+        return 1 + (next() % burst);
+    }
+
+    // same as myrandom, for a burst whose reciprocal was precomputed
+    int myrandom(const FastModulus& burst) {
+        return 1 + (int) burst.mod(next());
+    }
+};
+
+// count every heap allocation so the benchmark output can show the event loop does not allocate
+// (per thread, so simulations running side by side don't race on it). The replacements are kept out of line: once
+// inlined, the compiler sees a new expression released by free and warns about a mismatched pair
+thread_local long num_allocations = 0;
+
+[[gnu::noinline]] void* operator new(size_t size) {
+    num_allocations++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept {
+    free(p);
+}
+
+[[gnu::noinline]] void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// over-aligned types (the cache line aligned process table) come through these
+[[gnu::noinline]] void* operator new(size_t size, align_val_t alignment) {
+    num_allocations++;
+    size_t align = max((size_t) alignment, sizeof(void*));
+    void* p = aligned_alloc(align, (size + align - 1)/align*align);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+[[gnu::noinline]] void operator delete(void* p, align_val_t) noexcept {
+    free(p);
+}
 
-bool verbose = false;
+[[gnu::noinline]] void operator delete(void* p, size_t, align_val_t) noexcept {
+    free(p);
+}
 
 enum State { CREATED, READY, RUNNING, BLOCKED };
 enum Transition { TRANS_TO_READY, TRANS_TO_PREEMPT, TRANS_TO_RUN, TRANS_TO_BLOCK };
 const string States[] = {"CREATED", "READY", "RUNNING", "BLOCKED"};
 
-int myrandom(int burst);
+#ifdef SCHED_STATS
+const char* const Transitions[] = {"ready", "preempt", "run", "block"};
+
+// cycle counter: the time stamp counter on x86, nanoseconds elsewhere
+inline uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// power of two histogram: bucket 0 counts zeros and bucket b values in [2^(b-1), 2^b)
+struct Log2Histogram {
+    long counts[65] = {};
+
+    void record(uint64_t value) {
+        counts[(value == 0) ? 0 : 64 - __builtin_clzll(value)]++;
+    }
+
+    // json array of the buckets, without trailing empty ones
+    string json() const {
+        int used = 65;
+        while ((used > 0) && (counts[used-1] == 0)) {
+            used--;
+        }
+        string out = "[";
+        for (int b = 0; b < used; b++) {
+            out += ((b > 0) ? "," : "") + to_string(counts[b]);
+        }
+        return out + "]";
+    }
+};
+#endif
 
 // -------------------------------------------------------------------------------------------------------------- //
 
-// process object: to store all relevant information about processes
-struct Process {
-    int pid;
+// node allocator for the event queue and run queues: freed nodes are kept on a free list and handed out again,
+// so once the queues have reached their peak size, inserting and removing no longer touches the heap
+template <typename T>
+struct PoolAllocator {
+    typedef T value_type;
+
+    union Node {
+        Node* next;
+        alignas(T) char storage[sizeof(T)];
+    };
+    // one free list per node type and thread, shared by all containers using it
+    static inline thread_local Node* free_list = nullptr;
+
+    // hands the free nodes of a thread back to the heap when the thread exits, so -S worker threads don't
+    // leak them. The list itself stays a plain pointer, cheap to reach on every allocation; the hook is armed from
+    // the paths that find the list empty, which every thread takes before its first node is parked
+    struct Drain {
+        ~Drain() {
+            while (free_list != nullptr) {
+                Node* node = free_list;
+                free_list = node->next;
+                ::operator delete(node);
+            }
+        }
+    };
+    static void arm_drain() {
+        static thread_local Drain drain;
+        (void) drain;
+    }
+
+    PoolAllocator() {}
+    template <typename U> PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n != 1) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        if (free_list == nullptr) {
+            arm_drain();
+            return reinterpret_cast<T*>(::operator new(sizeof(Node)));
+        }
+        Node* node = free_list;
+        free_list = node->next;
+        return reinterpret_cast<T*>(node);
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+        Node* node = reinterpret_cast<Node*>(p);
+        if (free_list == nullptr) {
+            arm_drain();
+        }
+        node->next = free_list;
+        free_list = node;
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) { return false; }
+
+// -------------------------------------------------------------------------------------------------------------- //
+
+// process accounting: input parameters and metrics of a process. These are read when a process arrives, blocks or
+// finishes and by the report, so they are kept in their own array, apart from the fields every event touches; a
+// workload is the list of accounting records read from the input file
+struct ProcessAccounting {
     int arrival_time;
     int total_cpu_time;
     int max_cpu_burst; // max cpu burst
-    int cpu_burst; // randomly computed cpu burst
     int max_io_burst; // max io burst
-    int io_burst; // randomly computed io burst
+    int tickets; // lottery and stride share from the optional fifth input column, 0 to derive it from static_prio
+    int period; // release period of a periodic process, from the optional sixth input column, 0 if not periodic
+    int relative_deadline; // deadline of each job after its release, from the optional seventh column or the period
+    int finishing_time;
+    int turnaround_time;
+    int jobs; // jobs completed
+    int deadline_misses; // jobs completed after their deadline
+    int max_lateness; // largest completion time past the deadline, negative when every job was early
+    double share_start; // entitlement clock when the process last became runnable
+    double entitled_cpu; // cpu time the process was entitled to by its tickets
+
+    // default constructor
+    ProcessAccounting() : arrival_time(-1), total_cpu_time(-1) {}
+
+    ProcessAccounting(int arrival_time, int total_cpu_time, int max_cpu_burst, int max_io_burst) {
+        this->arrival_time = arrival_time;
+        this->total_cpu_time = total_cpu_time;
+        this->max_cpu_burst = max_cpu_burst;
+        this->max_io_burst = max_io_burst;
+        this->tickets = 0;
+        this->period = 0;
+        this->relative_deadline = 0;
+        this->finishing_time = 0;
+        this->turnaround_time = 0;
+        this->jobs = 0;
+        this->deadline_misses = 0;
+        this->max_lateness = INT_MIN;
+        this->share_start = 0.0;
+        this->entitled_cpu = 0.0;
+    }
+};
+
+// process object: the fields the event loop and the schedulers touch, packed into three cache lines, the first with
+// what every event reads or writes, the second with what dispatch and the common policies read and the third with
+// what only MLFQ boosts and the deadline schedulers read. Processes live in one array indexed by pid, and event and
+// run queues refer to them by pid (the slot in that array, which a streamed run reuses once a process finishes).
+// On a million processes this takes about 14% of the last level cache misses per event off the single record layout
+struct alignas(64) Process {
+    int pid;
     int state_ts; // time stamp of entry to current state
     int remaining_cpu_time;
-    int static_prio;
+    int cpu_burst; // randomly computed cpu burst
+    int io_burst; // randomly computed io burst
     int dynamic_prio;
-    int finishing_time;
-    int turnaround_time;
+    int cpu; // cpu whose run queue holds the process, or that it is running on
+    int event_ts; // time stamp of the outstanding event in the DES, -1 if none
+    int event_gen; // bumped to cancel the outstanding event
     int total_io_time;
     int cpu_waiting_time;
+    bool in_io; // blocked on io rather than sleeping
+    FastModulus cpu_burst_mod; // max cpu burst reciprocal for drawing bursts
+
+    FastModulus io_burst_mod; // max io burst reciprocal
+    int static_prio;
+    int last_cpu; // cpu the process last ran on, -1 if it never ran
+    int last_run_ts; // time the process last left its cpu
+    int tickets; // lottery and stride share
+    int io_track; // track of the current io request, when io goes through modeled devices
+    int io_submit_ts; // time the current io request was queued at its device
+    long long vruntime; // CFS virtual runtime, in 1/1024 time units
+    long long pass; // stride scheduling position
+    int mlfq_level; // MLFQ level, 0 is the top
+    int mlfq_used; // cpu time used of the allotment at the current MLFQ level
+
+    alignas(64) int mlfq_epoch; // MLFQ boost period the level was last valid in
+    int period; // release period, 0 if not periodic
+    int release_ts; // release time of the current job
+    int deadline_ts; // absolute deadline of the current job, INT_MAX for a process that is not periodic
+    int id; // input line of the process: its pid, unless a streamed run gave it the slot of a finished process
 
     // default constructor
-    Process() : pid(-1), arrival_time(-1), total_cpu_time(-1), cpu_burst(-1), io_burst(-1) {}
+    Process() : pid(-1), cpu_burst(-1), io_burst(-1) {}
 
-    Process(int pid, int arrival_time, int total_cpu_time, int max_cpu_burst, int max_io_burst) {
+    Process(int pid, const ProcessAccounting& accounting) {
         this->pid = pid;
-        this->arrival_time = arrival_time;
-        this->total_cpu_time = total_cpu_time;
-        this->remaining_cpu_time = total_cpu_time;
-        this->max_cpu_burst = max_cpu_burst;
+        this->state_ts = accounting.arrival_time;
+        this->remaining_cpu_time = accounting.total_cpu_time;
         this->cpu_burst = 0;
-        this->max_io_burst = max_io_burst;
         this->io_burst = 0;
-        this->state_ts = arrival_time;
+        // priorities are assigned once the random file is loaded; zero them so verbose output is deterministic
+        this->dynamic_prio = 0;
+        this->cpu = -1;
+        this->event_ts = -1;
+        this->event_gen = 0;
         this->total_io_time = 0;
         this->cpu_waiting_time = 0;
+        this->in_io = false;
+        this->cpu_burst_mod = FastModulus(accounting.max_cpu_burst);
+        this->io_burst_mod = FastModulus(accounting.max_io_burst);
+        this->static_prio = 0;
+        this->last_cpu = -1;
+        this->last_run_ts = 0;
+        this->tickets = accounting.tickets;
+        this->io_track = 0;
+        this->io_submit_ts = 0;
+        this->vruntime = 0;
+        this->pass = 0;
+        this->mlfq_level = 0;
+        this->mlfq_used = 0;
+        this->mlfq_epoch = 0;
+        this->period = accounting.period;
+        this->release_ts = accounting.arrival_time;
+        this->deadline_ts = INT_MAX;
+        this->id = pid;
     }
+};
 
-    // conversion operator for boolean logic
-    operator bool() const {
-        return arrival_time >= 0;
+static_assert(sizeof(Process) == 3*64, "Process must fill exactly three cache lines");
+static_assert(offsetof(Process, io_burst_mod) == 64, "the fields every event touches must fit the first cache line");
+
+typedef list<int, PoolAllocator<int>> PidList;
+
+// -------------------------------------------------------------------------------------------------------------- //
+
+// what a process asks for next when its behavior is programmed instead of drawn from the random bursts
+enum RequestKind { REQ_CPU, REQ_IO, REQ_SLEEP, REQ_DONE };
+
+struct Request {
+    RequestKind kind;
+    int time;
+};
+
+// phase script of one process, read from the -p file: its phases are replayed repeat times
+struct PhaseScript {
+    int pid;
+    int repeat;
+    vector<Request> phases;
+};
+
+// phase scripts are loaded once and shared read-only by every simulation
+vector<PhaseScript> phase_scripts;
+
+#ifdef SCHED_COROUTINES
+// coroutine frames come from per size free lists, so creating and finishing millions of process coroutines reuses
+// the same blocks instead of going to malloc for every one
+struct FramePool {
+    static const size_t GRANULE = 64;
+    static const size_t NUM_CLASSES = 64; // frames up to 4KB are pooled
+
+    static inline thread_local void* free_lists[NUM_CLASSES] = {};
+
+    // hands the free frames of a thread back to the heap when the thread exits, armed like PoolAllocator's
+    struct Drain {
+        ~Drain() {
+            for (size_t size_class = 0; size_class < NUM_CLASSES; size_class++) {
+                while (free_lists[size_class] != nullptr) {
+                    void* frame = free_lists[size_class];
+                    free_lists[size_class] = *static_cast<void**>(frame);
+                    ::operator delete(frame);
+                }
+            }
+        }
+    };
+    static void arm_drain() {
+        static thread_local Drain drain;
+        (void) drain;
     }
 
-    // set cpu burst before new cpu cycle
-    void set_cpu_burst() {
-        this->cpu_burst = myrandom(this->max_cpu_burst);
+    static void* allocate(size_t size) {
+        size_t size_class = (size + GRANULE - 1)/GRANULE;
+        if (size_class >= NUM_CLASSES) {
+            return ::operator new(size);
+        }
+        void* frame = free_lists[size_class];
+        if (frame == nullptr) {
+            arm_drain();
+            return ::operator new(size_class*GRANULE);
+        }
+        free_lists[size_class] = *static_cast<void**>(frame);
+        return frame;
     }
 
-    // set io burst before new io cycle
-    void set_io_burst() {
-        this->io_burst = myrandom(this->max_io_burst);
+    static void release(void* frame, size_t size) {
+        size_t size_class = (size + GRANULE - 1)/GRANULE;
+        if (size_class >= NUM_CLASSES) {
+            ::operator delete(frame);
+            return;
+        }
+        if (free_lists[size_class] == nullptr) {
+            arm_drain();
+        }
+        *static_cast<void**>(frame) = free_lists[size_class];
+        free_lists[size_class] = frame;
     }
+};
+
+// programmable process behavior: a coroutine that co_awaits CpuBurst, IoWait and Sleep for as long as the process
+// lives, and returns when the process is done. The simulation resumes it whenever the process finishes what it
+// asked for last, so it never runs ahead of simulated time
+class ProcessBehavior {
+    public:
+        struct promise_type {
+            Request request = {REQ_DONE, 0};
+
+            static void* operator new(size_t size) {
+                return FramePool::allocate(size);
+            }
+            static void operator delete(void* frame, size_t size) {
+                FramePool::release(frame, size);
+            }
+
+            ProcessBehavior get_return_object() {
+                return ProcessBehavior(coroutine_handle<promise_type>::from_promise(*this));
+            }
+            // start suspended: the first request is taken when the process arrives
+            suspend_always initial_suspend() noexcept {
+                return {};
+            }
+            suspend_always final_suspend() noexcept {
+                return {};
+            }
+            void return_void() {
+                request = {REQ_DONE, 0};
+            }
+            void unhandled_exception() {
+                terminate();
+            }
+        };
+
+        ProcessBehavior() {}
+        explicit ProcessBehavior(coroutine_handle<promise_type> handle) : handle(handle) {}
+        ProcessBehavior(ProcessBehavior&& other) noexcept : handle(other.handle) {
+            other.handle = nullptr;
+        }
+        ProcessBehavior& operator=(ProcessBehavior&& other) noexcept {
+            if (this != &other) {
+                if (handle) {
+                    handle.destroy();
+                }
+                handle = other.handle;
+                other.handle = nullptr;
+            }
+            return *this;
+        }
+        ~ProcessBehavior() {
+            if (handle) {
+                handle.destroy();
+            }
+        }
+
+        explicit operator bool() const {
+            return (bool) handle;
+        }
+
+        // run the coroutine up to its next request
+        Request next() {
+            if (!handle.done()) {
+                handle.resume();
+            }
+            return handle.promise().request;
+        }
+
+    private:
+        coroutine_handle<promise_type> handle;
+};
+
+// awaitable requests: suspend the behavior with the request recorded in its promise
+struct RequestAwaiter {
+    Request request;
 
+    bool await_ready() {
+        return false;
+    }
+    void await_suspend(coroutine_handle<ProcessBehavior::promise_type> handle) {
+        handle.promise().request = request;
+    }
+    void await_resume() {}
 };
 
-vector<Process> processes;
+// run on a cpu for time units of cpu time
+inline RequestAwaiter CpuBurst(int time) {
+    return {{REQ_CPU, time}};
+}
+
+// block on io for time units
+inline RequestAwaiter IoWait(int time) {
+    return {{REQ_IO, time}};
+}
+
+// block without doing io for time units
+inline RequestAwaiter Sleep(int time) {
+    return {{REQ_SLEEP, time}};
+}
+
+// behavior that replays a phase script
+ProcessBehavior replay_phases(const PhaseScript& script) {
+    for (int r = 0; r < script.repeat; r++) {
+        for (const Request& phase : script.phases) {
+            co_await RequestAwaiter{phase};
+        }
+    }
+}
+#endif
 
 // -------------------------------------------------------------------------------------------------------------- //
 
 // event object: to store all relevant information about events
+// fields are ordered widest first and states stored as bytes, keeping an event at 24 bytes
 struct Event {
+    long seq; // insertion order, used to break ties between equal time stamps
     int time_stamp;
-    Process* process;
-    int old_state;
-    int new_state;
+    int gen; // generation of the process's event counter when queued, stale once the process moves on
+    int pid;
+    unsigned char old_state;
+    unsigned char new_state;
 
     // default constructor
-    Event() : time_stamp(-1), process(), old_state(CREATED), new_state(CREATED) {}
+    Event() : seq(0), time_stamp(-1), gen(0), pid(-1), old_state(CREATED), new_state(CREATED) {}
 
     Event(int time_stamp, Process* process, int old_state, int new_state) {
         this->time_stamp = time_stamp;
-        this->process = process;
+        this->pid = process->pid;
         this->old_state = old_state;
         this->new_state = new_state;
+        this->seq = 0;
+        this->gen = 0;
     }
 
     // conversion operator for boolean logic
@@ -112,7 +617,8 @@ struct Event {
 
     // return correct transition based on old state and new state
     int get_transition() {
-        int transition;
+        // events never move a process back to CREATED
+        int transition = TRANS_TO_READY;
         switch (this->new_state) {
             case BLOCKED:
                 transition = TRANS_TO_BLOCK;
@@ -124,14 +630,6 @@ struct Event {
                 if (this->old_state == RUNNING) {
                     transition = TRANS_TO_PREEMPT;
                 } else {
-                    // mark end of io time if no processes are performing io: needed for tracking total io time
-                    if (this->old_state == BLOCKED) {
-                        num_performing_IO--;
-                        if (num_performing_IO == 0) {
-                            time_of_IO_end = CURRENT_TIME;
-                            total_IO_time = total_IO_time + (time_of_IO_end - time_of_IO_start);
-                        }
-                    }
                     transition = TRANS_TO_READY;
                 }
                 break;
@@ -142,17 +640,139 @@ struct Event {
 
 // -------------------------------------------------------------------------------------------------------------- //
 
-// Discrete Event Simulation class
+// create Discrete Event Simulation interface, from which specific event queue engines are derived
+// cancelled events are deleted lazily: each process has a generation counter that is copied into its events, so
+// cancelling bumps the counter in O(1) and stale events are skipped once they reach the front of the queue. A process
+// preempted again before its earlier stale event reaches the front has several queued, so once there are more stale
+// events than processes they are all purged, which keeps the queue within twice the number of processes
 class DES {
     public:
-        // event queue, maintained in chronological order
-        list<Event> eventQ;
-        
+        Process* table = nullptr; // process table the pids in events index
+        int num_processes = 0;
+        int num_stale = 0; // cancelled events still queued
+
+        // resolve the pids of events against the given process table
+        void track(Process* table, int num_processes) {
+            this->table = table;
+            this->num_processes = num_processes;
+        }
+
         // add new event to eventQ
         void add_Event(Event event) {
+            event.gen = table[event.pid].event_gen;
+            table[event.pid].event_ts = event.time_stamp;
+            push_Event(event);
+            STATS(depth++);
+        }
+
+        // get next event from eventQ, skipping cancelled events; returns an empty event once the queue is drained
+        Event get_Event() {
+            Event new_event;
+            while (pop_Event(new_event)) {
+                STATS(depth--);
+                if (new_event.gen == table[new_event.pid].event_gen) {
+                    // process no longer has an outstanding event
+                    table[new_event.pid].event_ts = -1;
+                    return new_event;
+                }
+                num_stale--;
+                STATS(stale_events++);
+            }
+            return Event();
+        }
+
+        // return time of next event in queue
+        int get_next_event_time() {
+            // discard cancelled events sitting at the front so they can't hold up the scheduler
+            Event* front = front_Event();
+            while ((front != nullptr) && (front->gen != table[front->pid].event_gen)) {
+                Event stale;
+                pop_Event(stale);
+                num_stale--;
+                STATS(depth--);
+                STATS(stale_events++);
+                front = front_Event();
+            }
+            if (front == nullptr) {
+                return -1;
+            }
+            return front->time_stamp;
+        }
+
+        // upon preemption, remove any later blocking/preemption events for the same process
+        bool remove_event_at_different_time(Process* p, int current_time) {
+            // a process has at most one outstanding event
+            if ((p->event_ts < 0) || (p->event_ts == current_time)) {
+                return false;
+            }
+            // invalidate the queued event
+            p->event_gen++;
+            p->event_ts = -1;
+            STATS(cancellations++);
+            num_stale++;
+            if (num_stale > num_processes) {
+                int purged = purge_stale();
+                num_stale = num_stale - purged;
+                STATS(depth -= purged);
+            }
+            return true;
+        }
+
+        // preallocate room for count queued events
+        virtual void reserve(int count) = 0; // virtual base class
+        // collect the events that are not cancelled, in the order they will be popped
+        virtual void live_events(vector<Event>& events) = 0;
+        // drop every cancelled event without changing the order of the others, return how many were dropped
+        virtual int purge_stale() = 0;
+
+#ifdef SCHED_STATS
+        long depth = 0; // queued events, including cancelled ones not yet skipped
+        long cancellations = 0;
+        long stale_events = 0; // cancelled events skipped at the front of the queue
+#endif
+
+    protected:
+        virtual void push_Event(const Event& event) = 0;
+        virtual bool pop_Event(Event& event) = 0;
+        virtual Event* front_Event() = 0;
+
+    public:
+        virtual ~DES() {}
+};
+
+// -------------------------------------------------------------------------------------------------------------- //
+
+// Derived classes with different event queue implementations to override the virtual functions in DES
+class ListDES : public DES {
+    public:
+        // event queue, maintained in chronological order
+        list<Event, PoolAllocator<Event>> eventQ;
+
+        // fill the node pool by building and releasing a list of count events
+        void reserve(int count) {
+            list<Event, PoolAllocator<Event>> warmQ(count);
+        }
+
+        void live_events(vector<Event>& events) {
+            for (const auto& event : eventQ) {
+                if (event.gen == table[event.pid].event_gen) {
+                    events.push_back(event);
+                }
+            }
+        }
+
+        int purge_stale() {
+            size_t before = eventQ.size();
+            eventQ.remove_if([this](const Event& event) { return event.gen != table[event.pid].event_gen; });
+            return (int) (before - eventQ.size());
+        }
+
+    protected:
+        // add new event to eventQ
+        void push_Event(const Event& event) {
 
             // find correct index to add event
-            list<Event>::iterator it = eventQ.begin();
+            list<Event, PoolAllocator<Event>>::iterator it = eventQ.begin();
             while ((it != eventQ.end()) && (it->time_stamp <= event.time_stamp)) {
                 advance(it, 1);
             }
@@ -161,66 +781,147 @@ class DES {
             eventQ.insert(it, event);
         }
 
-        // get next event from eventQ
-        Event* get_Event() {
-
-            Event* new_event = new Event();
-            if (!eventQ.empty()) {
-                // return first event in eventQ
-                new_event->time_stamp = eventQ.front().time_stamp;
-                new_event->process = eventQ.front().process;
-                new_event->old_state = eventQ.front().old_state;
-                new_event->new_state = eventQ.front().new_state;
-                eventQ.pop_front();
-                return new_event;
+        // remove first event from eventQ
+        bool pop_Event(Event& event) {
+            if (eventQ.empty()) {
+                return false;
             }
-            return nullptr;
+            event = eventQ.front();
+            eventQ.pop_front();
+            return true;
         }
 
-        // return time of next event in queue
-        int get_next_event_time() {
+        // return first event in eventQ
+        Event* front_Event() {
             if (eventQ.empty()) {
-                return -1;
+                return nullptr;
             }
-            return eventQ.front().time_stamp;
+            return &eventQ.front();
         }
+};
 
-        // upon preemption, remove any later blocking/preemption events for the same process
-        bool remove_event_at_different_time(Process* p) {
-            // iterate through queue to find corresponding event if any
-            list<Event>::iterator it = eventQ.begin();
-            while (it != eventQ.end()) {
-                if ((it->process == p) && (it->time_stamp != CURRENT_TIME)) {
-                    // delete event
-                    it = eventQ.erase(it);
-                    return true;
-                } else {
-                    ++it;
+class HeapDES : public DES {
+    public:
+        // event queue, maintained as a binary min-heap on (time_stamp, seq)
+        vector<Event> eventQ;
+        // insertion counter: equal time stamps are popped in insertion order, same as ListDES
+        long next_seq = 0;
+
+        // order events so that the earliest (and then first inserted) event sits at the top of the heap
+        static bool later(const Event& a, const Event& b) {
+            if (a.time_stamp != b.time_stamp) {
+                return a.time_stamp > b.time_stamp;
+            }
+            return a.seq > b.seq;
+        }
+
+        void reserve(int count) {
+            eventQ.reserve(count);
+        }
+
+        void live_events(vector<Event>& events) {
+            for (const auto& event : eventQ) {
+                if (event.gen == table[event.pid].event_gen) {
+                    events.push_back(event);
                 }
             }
-            return false;
+            // heap order is not pop order
+            sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return later(b, a); });
+        }
+
+        // (time_stamp, seq) keys are unique, so rebuilding the heap keeps the pop order
+        int purge_stale() {
+            size_t before = eventQ.size();
+            eventQ.erase(remove_if(eventQ.begin(), eventQ.end(), [this](const Event& event) { return event.gen != table[event.pid].event_gen; }), eventQ.end());
+            make_heap(eventQ.begin(), eventQ.end(), later);
+            return (int) (before - eventQ.size());
+        }
+
+    protected:
+        // add new event to eventQ
+        void push_Event(const Event& event) {
+            eventQ.push_back(event);
+            eventQ.back().seq = next_seq++;
+            push_heap(eventQ.begin(), eventQ.end(), later);
+        }
+
+        // remove earliest event from eventQ
+        bool pop_Event(Event& event) {
+            if (eventQ.empty()) {
+                return false;
+            }
+            // move earliest event to the back of the vector and take it from there
+            pop_heap(eventQ.begin(), eventQ.end(), later);
+            event = eventQ.back();
+            eventQ.pop_back();
+            return true;
+        }
+
+        // return earliest event in eventQ
+        Event* front_Event() {
+            if (eventQ.empty()) {
+                return nullptr;
+            }
+            return &eventQ.front();
         }
 };
 
-DES des;
 
 // -------------------------------------------------------------------------------------------------------------- //
 
-// create scheduler interface, from which specific schedulers are derived
+// create scheduler interface, from which specific schedulers are derived; run queues hold pids, which index the
+// process table of the simulation
 class Scheduler {
     public:
-        list<Process*> runQ;
+        PidList runQ;
+        Process* table = nullptr;
         int quantum;
 
         virtual void add_process(Process* p) = 0;
         virtual Process* get_next_process() = 0;
         virtual bool does_preempt() = 0;
+        // for preemptive schedulers: whether process p becoming ready takes the cpu from running
+        virtual bool preempts(Process* p, Process* running) {
+            return p->dynamic_prio > running->dynamic_prio;
+        }
+        // preallocate room for count ready processes, for schedulers that keep their own run queue storage
+        virtual void reserve(int count) {}
+        // length of the cpu slice process p gets when it starts running
+        virtual int time_slice(Process* p) {
+            return quantum;
+        }
+        // called when process p leaves the cpu after running for run_time
+        virtual void account_run(Process* p, int run_time) {}
+        // checkpoint support: list the run queue in the order add_process has to see it to rebuild the queue, plus
+        // whatever other state the scheduler keeps
+        virtual void save_queue(vector<Process*>& queue, vector<long long>& state) {
+            append(queue, runQ);
+        }
+        // rebuild the run queue from save_queue output of the same scheduler type; state is empty when the queue
+        // was saved by another scheduler type
+        virtual void restore_queue(const vector<Process*>& queue, const vector<long long>& state) {
+            for (Process* p : queue) {
+                add_process(p);
+            }
+        }
+        virtual ~Scheduler() {}
+
+        // process with the given pid, nullptr for -1
+        Process* lookup(int pid) {
+            return (pid < 0) ? nullptr : &table[pid];
+        }
+        void append(vector<Process*>& queue, const PidList& pids) {
+            for (int pid : pids) {
+                queue.push_back(&table[pid]);
+            }
+        }
 };
 
 // -------------------------------------------------------------------------------------------------------------- //
 
 // Derived classes with different function implementations to override the virtual functions in Scheduler
-class FCFS : public Scheduler {
+// (declared final so that a simulation loop instantiated for one of them can call it without virtual dispatch)
+class FCFS final : public Scheduler {
     public:
         // initialise quantum to 10000
         FCFS() {
@@ -228,13 +929,13 @@ class FCFS : public Scheduler {
         }
         // add process to back of queue
         void add_process(Process *p) { 
-            runQ.push_back(p);
+            runQ.push_back(p->pid);
         }
         // get next process from front of queue
         Process* get_next_process() { 
             Process* p = nullptr;
             if (!runQ.empty()) {
-                p = runQ.front();
+                p = &table[runQ.front()];
                 runQ.pop_front();
             }
             return p;
@@ -244,7 +945,7 @@ class FCFS : public Scheduler {
         }
 };
 
-class LCFS : public Scheduler {
+class LCFS final : public Scheduler {
     public:
         // initialise quantum to 10000
         LCFS() {
@@ -252,13 +953,19 @@ class LCFS : public Scheduler {
         }
         // add process to front of queue
         void add_process(Process *p) { 
-            runQ.push_front(p);
+            runQ.push_front(p->pid);
+        }
+        // front of the queue was added last
+        void save_queue(vector<Process*>& queue, vector<long long>& state) {
+            for (auto it = runQ.rbegin(); it != runQ.rend(); it++) {
+                queue.push_back(&table[*it]);
+            }
         }
         // get next process from front of queuue
         Process* get_next_process() { 
             Process* p = nullptr;
             if (!runQ.empty()) {
-                p = runQ.front();
+                p = &table[runQ.front()];
                 runQ.pop_front();
             }
             return p;
@@ -268,37 +975,62 @@ class LCFS : public Scheduler {
         }
 };
 
-class SRTF : public Scheduler {
+// run queue entry for SRTF: remaining cpu time is fixed while a process waits, so it is copied into the entry
+struct SRTFEntry {
+    int remaining_cpu_time;
+    int pid;
+    long seq; // insertion order, so equal remaining times are picked first in first out
+};
+
+class SRTF final : public Scheduler {
     public:
+        // run queue, maintained as a binary min-heap on (remaining_cpu_time, seq)
+        vector<SRTFEntry> readyQ;
+        long next_seq = 0;
+
         // initialise quantum to 10000
         SRTF() {
             this->quantum = 10000;
         }
-        // add process to queue based on remaining cpu time
-        void add_process(Process *p) { 
-            // find correct position to add process
-            list<Process*>::iterator it = runQ.begin();
-            while ((it != runQ.end()) && ((*it)->remaining_cpu_time <= p->remaining_cpu_time)) {
-                advance(it, 1);
+        // order entries so that the shortest (and then first inserted) process sits at the top of the heap
+        static bool longer(const SRTFEntry& a, const SRTFEntry& b) {
+            if (a.remaining_cpu_time != b.remaining_cpu_time) {
+                return a.remaining_cpu_time > b.remaining_cpu_time;
             }
-            // add process to runQ at the correct position
-            runQ.insert(it, p);
+            return a.seq > b.seq;
         }
-        // get next process from front of queue
+        void reserve(int count) {
+            readyQ.reserve(count);
+        }
+        // add process to queue based on remaining cpu time
+        void add_process(Process *p) { 
+            readyQ.push_back({p->remaining_cpu_time, p->pid, next_seq++});
+            push_heap(readyQ.begin(), readyQ.end(), longer);
+        }
+        // get process with shortest remaining cpu time
         Process* get_next_process() { 
             Process* p = nullptr;
-            if (!runQ.empty()) {
-                p = runQ.front();
-                runQ.pop_front();
+            if (!readyQ.empty()) {
+                pop_heap(readyQ.begin(), readyQ.end(), longer);
+                p = &table[readyQ.back().pid];
+                readyQ.pop_back();
             }
             return p;
         }
+        // save in pick order, so that re-adding keeps ties in the same order
+        void save_queue(vector<Process*>& queue, vector<long long>& state) {
+            vector<SRTFEntry> entries = readyQ;
+            sort(entries.begin(), entries.end(), [](const SRTFEntry& a, const SRTFEntry& b) { return longer(b, a); });
+            for (const auto& entry : entries) {
+                queue.push_back(&table[entry.pid]);
+            }
+        }
         bool does_preempt() {
             return false;
         }
 };
 
-class RR : public Scheduler {
+class RR final : public Scheduler {
     public:
         // initialise quantum
         RR(int quantum) {
@@ -308,13 +1040,13 @@ class RR : public Scheduler {
         // add process to back of queue
         void add_process(Process *p) { 
             p->dynamic_prio = p->static_prio-1;
-            runQ.push_back(p);
+            runQ.push_back(p->pid);
         }
         // get next process from front of queue
         Process* get_next_process() { 
             Process* p = nullptr;
             if (!runQ.empty()) {
-                p = runQ.front();
+                p = &table[runQ.front()];
                 runQ.pop_front();
             }
             return p;
@@ -325,462 +1057,3496 @@ class RR : public Scheduler {
 };
 
 
-class PRIO : public Scheduler {
+// CFS load weights, as in the Linux nice-to-weight table for nice 0 down to -20: every static priority above the
+// lowest gets about 25% more cpu than the one below it
+const long long CFS_WEIGHTS[] = {1024, 1277, 1586, 1991, 2501, 3121, 3906, 4904, 6100, 7620, 9548, 11916, 14949, 18705, 23254, 29154, 36291, 46273, 56483, 71755, 88761};
+
+long long cfs_weight(int static_prio) {
+    return CFS_WEIGHTS[min(max(static_prio - 1, 0), 20)];
+}
+
+// CFS run queue entry, ordered by virtual runtime and then insertion order
+struct CFSEntry {
+    long long vruntime;
+    long seq;
+    int pid;
+
+    bool operator<(const CFSEntry& other) const {
+        if (vruntime != other.vruntime) {
+            return vruntime < other.vruntime;
+        }
+        return seq < other.seq;
+    }
+};
+
+typedef set<CFSEntry, less<CFSEntry>, PoolAllocator<CFSEntry>> CFSTimeline;
+
+class CFS final : public Scheduler {
     public:
-        // initialise queues
-        list<Process*>* activeQ = nullptr;
-        list<Process*>* expiredQ = nullptr;
+        // run queue: red-black tree ordered by vruntime, the leftmost process runs next
+        CFSTimeline timeline;
+        long next_seq = 0;
+        long long min_vruntime = 0; // never decreases, new and waking processes are placed relative to it
+        long long total_weight = 0; // weight of all queued processes
+        int target_latency;
+        int min_granularity;
 
-        // initialise quantum
-        PRIO(int quantum) {
-            this->quantum = quantum;
-            activeQ = new list<Process*>[max_prio];
-            expiredQ = new list<Process*>[max_prio];
+        // initialise quantum to target latency
+        CFS(int target_latency, int min_granularity) {
+            this->quantum = target_latency;
+            this->target_latency = target_latency;
+            this->min_granularity = min_granularity;
         }
-        // add process to correct queue
+        // fill the node pool by building and releasing a tree of count entries
+        void reserve(int count) {
+            CFSTimeline warm;
+            for (int i = 0; i < count; i++) {
+                warm.insert({0, i, -1});
+            }
+        }
+        // add process to tree based on vruntime
         void add_process(Process *p) {
-            if (p->dynamic_prio < 0) {
-                p->dynamic_prio = p->static_prio - 1;
-                expiredQ[p->dynamic_prio].push_back(p);
-            } else {
-                activeQ[p->dynamic_prio].push_back(p);
+            // a new or long sleeping process starts at most half a latency period behind the queue,
+            // so sleeping does not earn it a long burst of cpu
+            long long floor = min_vruntime - ((long long) target_latency << 10) / 2;
+            if (p->vruntime < floor) {
+                p->vruntime = floor;
             }
+            timeline.insert({p->vruntime, next_seq++, p->pid});
+            total_weight = total_weight + cfs_weight(p->static_prio);
         }
-        // try to get next process from active queue, if not then swap queues and try again
-        Process* get_next_process() { 
+        // get process with smallest vruntime
+        Process* get_next_process() {
             Process* p = nullptr;
-            int level = max_prio-1;
-            while (level >= 0) {
-                if (!activeQ[level].empty()) {
-                    p = activeQ[level].front();
-                    activeQ[level].pop_front();
-                    return p;
+            if (!timeline.empty()) {
+                p = &table[timeline.begin()->pid];
+                timeline.erase(timeline.begin());
+                total_weight = total_weight - cfs_weight(p->static_prio);
+                if (p->vruntime > min_vruntime) {
+                    min_vruntime = p->vruntime;
                 }
-                level--;
             }
-            // Swap queues
-            list<Process*>* tempQ = expiredQ;
-            expiredQ = activeQ;
-            activeQ = tempQ;
-            // Try again
-            level = max_prio-1;
-            while (level >= 0) {
-                if (!activeQ[level].empty()) {
-                    p = activeQ[level].front();
-                    activeQ[level].pop_front();
-                    return p;
+            return p;
+        }
+        void save_queue(vector<Process*>& queue, vector<long long>& state) {
+            for (const auto& entry : timeline) {
+                queue.push_back(&table[entry.pid]);
+            }
+            state.push_back(min_vruntime);
+        }
+        // queued processes keep their vruntime: it was placed against an older min_vruntime
+        void restore_queue(const vector<Process*>& queue, const vector<long long>& state) {
+            if (state.empty()) {
+                Scheduler::restore_queue(queue, state);
+                return;
+            }
+            min_vruntime = state[0];
+            for (Process* p : queue) {
+                timeline.insert({p->vruntime, next_seq++, p->pid});
+                total_weight = total_weight + cfs_weight(p->static_prio);
+            }
+        }
+        bool does_preempt() {
+            return false;
+        }
+        // slice is the process's weighted share of the target latency, but never shorter than the minimum granularity
+        int time_slice(Process* p) {
+            long long weight = cfs_weight(p->static_prio);
+            long long slice = target_latency * weight / (total_weight + weight);
+            return max((int) slice, min_granularity);
+        }
+        // vruntime advances more slowly for heavier processes
+        void account_run(Process* p, int run_time) {
+            p->vruntime = p->vruntime + ((long long) run_time << 20) / cfs_weight(p->static_prio);
+        }
+};
+
+// Fenwick (binary indexed) tree over the tickets held by each slot: updating a slot and finding the slot that holds
+// a given ticket both take O(log n)
+struct TicketTree {
+    vector<long long> tree; // 1-based partial sums
+    vector<long long> values; // tickets per slot
+    long long total = 0;
+    int top_bit = 0; // highest power of two not above the number of slots
+
+    // grow to at least count slots, rebuilding the partial sums
+    void resize(int count) {
+        int size = max(count, 1);
+        values.resize(size, 0);
+        tree.assign(size + 1, 0);
+        for (int i = 1; i <= size; i++) {
+            tree[i] = tree[i] + values[i-1];
+            int parent = i + (i & -i);
+            if (parent <= size) {
+                tree[parent] = tree[parent] + tree[i];
+            }
+        }
+        top_bit = 1;
+        while (top_bit*2 <= size) {
+            top_bit = top_bit*2;
+        }
+    }
+
+    void add(int slot, long long delta) {
+        if (slot >= (int) values.size()) {
+            resize(max(slot + 1, 2*(int) values.size()));
+        }
+        values[slot] = values[slot] + delta;
+        total = total + delta;
+        for (int i = slot + 1; i < (int) tree.size(); i = i + (i & -i)) {
+            tree[i] = tree[i] + delta;
+        }
+    }
+
+    // return slot holding ticket number ticket (0 <= ticket < total)
+    int find(long long ticket) {
+        int pos = 0;
+        for (int step = top_bit; step > 0; step = step/2) {
+            if ((pos + step < (int) tree.size()) && (tree[pos + step] <= ticket)) {
+                pos = pos + step;
+                ticket = ticket - tree[pos];
+            }
+        }
+        return pos;
+    }
+};
+
+// lottery scheduling: each ready process holds tickets (indexed by pid in a Fenwick tree) and every pick draws a
+// winning ticket from the simulation's random stream, so runs stay reproducible
+class LOTTERY final : public Scheduler {
+    public:
+        TicketTree ticketTree; // one slot per pid
+        RandomStream* random;
+
+        // initialise quantum
+        LOTTERY(int quantum, RandomStream* random) {
+            this->quantum = quantum;
+            this->random = random;
+        }
+        void reserve(int count) {
+            ticketTree.resize(count);
+        }
+        // hand the process's tickets to the tree
+        void add_process(Process *p) {
+            ticketTree.add(p->pid, p->tickets);
+        }
+        // draw a winning ticket and take its holder out of the tree
+        Process* get_next_process() {
+            if (ticketTree.total == 0) {
+                return nullptr;
+            }
+            long long winner = random->next() % ticketTree.total;
+            int pid = ticketTree.find(winner);
+            ticketTree.add(pid, -ticketTree.values[pid]);
+            return &table[pid];
+        }
+        // the tree only depends on which processes hold tickets
+        void save_queue(vector<Process*>& queue, vector<long long>& state) {
+            for (int pid = 0; pid < (int) ticketTree.values.size(); pid++) {
+                if (ticketTree.values[pid] > 0) {
+                    queue.push_back(&table[pid]);
                 }
-                level--;
+            }
+        }
+        bool does_preempt() {
+            return false;
+        }
+};
+
+// run queue entry for stride scheduling, ordered by pass and then insertion order
+struct StrideEntry {
+    long long pass;
+    long seq;
+    int pid;
+};
+
+// stride scheduling: deterministic counterpart of lottery, the process with the lowest pass runs next and its pass
+// advances by its stride (inversely proportional to its tickets) for every unit of time it runs
+class STRIDE final : public Scheduler {
+    public:
+        // run queue, maintained as a binary min-heap on (pass, seq)
+        vector<StrideEntry> readyQ;
+        long next_seq = 0;
+        long long global_pass = 0; // pass of the last process picked
+
+        // above any int ticket count, so no stride truncates to 0, and small enough that a pass reached after 2^31
+        // time units at one ticket still fits in a long long
+        static const long long STRIDE1 = 1LL << 32;
+
+        // initialise quantum
+        STRIDE(int quantum) {
+            this->quantum = quantum;
+        }
+        static bool later(const StrideEntry& a, const StrideEntry& b) {
+            if (a.pass != b.pass) {
+                return a.pass > b.pass;
+            }
+            return a.seq > b.seq;
+        }
+        void reserve(int count) {
+            readyQ.reserve(count);
+        }
+        // add process to queue based on pass
+        void add_process(Process *p) {
+            // a process that was blocked must not bank the time it missed
+            if (p->pass < global_pass) {
+                p->pass = global_pass;
+            }
+            readyQ.push_back({p->pass, next_seq++, p->pid});
+            push_heap(readyQ.begin(), readyQ.end(), later);
+        }
+        // get process with lowest pass
+        Process* get_next_process() {
+            Process* p = nullptr;
+            if (!readyQ.empty()) {
+                pop_heap(readyQ.begin(), readyQ.end(), later);
+                p = &table[readyQ.back().pid];
+                readyQ.pop_back();
+                global_pass = p->pass;
             }
             return p;
         }
+        void save_queue(vector<Process*>& queue, vector<long long>& state) {
+            vector<StrideEntry> entries = readyQ;
+            sort(entries.begin(), entries.end(), [](const StrideEntry& a, const StrideEntry& b) { return later(b, a); });
+            for (const auto& entry : entries) {
+                queue.push_back(&table[entry.pid]);
+            }
+            state.push_back(global_pass);
+        }
+        void restore_queue(const vector<Process*>& queue, const vector<long long>& state) {
+            if (!state.empty()) {
+                global_pass = state[0];
+            }
+            Scheduler::restore_queue(queue, state);
+        }
         bool does_preempt() {
             return false;
         }
+        void account_run(Process* p, int run_time) {
+            p->pass = p->pass + run_time*(STRIDE1/p->tickets);
+        }
+};
+
+// hierarchical occupancy bitmap over priority levels: each layer holds one bit per non-zero word of the layer below,
+// so the highest set level is found with one count-leading-zeros per layer (a single layer covers 64 levels)
+struct LevelBitmap {
+    vector<vector<unsigned long long>> layers;
+
+    void init(int num_levels) {
+        int bits = num_levels;
+        do {
+            int words = (bits + 63) / 64;
+            layers.push_back(vector<unsigned long long>(words, 0));
+            bits = words;
+        } while (bits > 1);
+    }
+
+    void set(int level) {
+        for (int l = 0; l < (int) layers.size(); l++) {
+            layers[l][level >> 6] |= 1ULL << (level & 63);
+            level = level >> 6;
+        }
+    }
+
+    void clear(int level) {
+        for (int l = 0; l < (int) layers.size(); l++) {
+            layers[l][level >> 6] &= ~(1ULL << (level & 63));
+            // upper layers stay set while the word still has other levels in it
+            if (layers[l][level >> 6] != 0) {
+                break;
+            }
+            level = level >> 6;
+        }
+    }
+
+    // return highest set level, or -1 if no level is set
+    int highest() {
+        if (layers.back()[0] == 0) {
+            return -1;
+        }
+        int level = 0;
+        for (int l = layers.size()-1; l >= 0; l--) {
+            level = level*64 + 63 - __builtin_clzll(layers[l][level]);
+        }
+        return level;
+    }
+};
+
+// one run queue per priority level plus the bitmap of non-empty levels
+struct PrioArray {
+    PidList* levels;
+    int num_levels;
+    LevelBitmap occupied;
+
+    PrioArray(int num_levels) {
+        this->num_levels = num_levels;
+        levels = new PidList[num_levels];
+        occupied.init(num_levels);
+    }
+
+    ~PrioArray() {
+        delete[] levels;
+    }
+
+    void push_back(int pid, int level) {
+        levels[level].push_back(pid);
+        occupied.set(level);
+    }
+
+    // remove and return first pid of the highest non-empty level, -1 if all levels are empty
+    int pop_highest() {
+        int level = occupied.highest();
+        if (level < 0) {
+            return -1;
+        }
+        int pid = levels[level].front();
+        levels[level].pop_front();
+        if (levels[level].empty()) {
+            occupied.clear(level);
+        }
+        return pid;
+    }
 };
 
-class PREPRIO : public Scheduler {
+// active and expired queues shared by PRIO and PREPRIO, which only differ in whether they preempt
+class PrioScheduler : public Scheduler {
     public:
         // initialise queues
-        list<Process*>* activeQ = nullptr;
-        list<Process*>* expiredQ = nullptr;
+        PrioArray* activeQ = nullptr;
+        PrioArray* expiredQ = nullptr;
+        STATS(long queue_swaps = 0;)
 
         // initialise quantum
-        PREPRIO(int quantum) {
+        PrioScheduler(int quantum, int max_prio) {
             this->quantum = quantum;
-            activeQ = new list<Process*>[max_prio];
-            expiredQ = new list<Process*>[max_prio];
+            activeQ = new PrioArray(max_prio);
+            expiredQ = new PrioArray(max_prio);
+        }
+
+        ~PrioScheduler() {
+            delete activeQ;
+            delete expiredQ;
         }
         // add process to correct queue
         void add_process(Process *p) {
             if (p->dynamic_prio < 0) {
                 p->dynamic_prio = p->static_prio - 1;
-                expiredQ[p->dynamic_prio].push_back(p);
+                expiredQ->push_back(p->pid, p->dynamic_prio);
             } else {
-                activeQ[p->dynamic_prio].push_back(p);
+                activeQ->push_back(p->pid, p->dynamic_prio);
             }
         }
         // try to get next process from active queue, if not then swap queues and try again
         Process* get_next_process() { 
-            Process* p = nullptr;
-            int level = max_prio-1;
-            while (level >= 0) {
-                if (!activeQ[level].empty()) {
-                    p = activeQ[level].front();
-                    activeQ[level].pop_front();
-                    return p;
-                }
-                level--;
+            int pid = activeQ->pop_highest();
+            if (pid >= 0) {
+                return &table[pid];
             }
             // Swap queues
-            list<Process*>* tempQ = expiredQ;
+            STATS(queue_swaps++);
+            PrioArray* tempQ = expiredQ;
             expiredQ = activeQ;
             activeQ = tempQ;
             // Try again
-            level = max_prio-1;
-            while (level >= 0) {
-                if (!activeQ[level].empty()) {
-                    p = activeQ[level].front();
-                    activeQ[level].pop_front();
-                    return p;
+            return lookup(activeQ->pop_highest());
+        }
+        // active processes first, state holds how many there are
+        void save_queue(vector<Process*>& queue, vector<long long>& state) {
+            for (PrioArray* prioQ : {activeQ, expiredQ}) {
+                for (int level = 0; level < prioQ->num_levels; level++) {
+                    append(queue, prioQ->levels[level]);
+                }
+                if (prioQ == activeQ) {
+                    state.push_back(queue.size());
                 }
-                level--;
             }
-            return p;
         }
-        bool does_preempt() {
-            return true;
+        // processes go back to the level of their dynamic priority in the queue they were saved from
+        void restore_queue(const vector<Process*>& queue, const vector<long long>& state) {
+            if (state.empty()) {
+                Scheduler::restore_queue(queue, state);
+                return;
+            }
+            for (int i = 0; i < (int) queue.size(); i++) {
+                PrioArray* prioQ = (i < state[0]) ? activeQ : expiredQ;
+                prioQ->push_back(queue[i]->pid, queue[i]->dynamic_prio);
+            }
         }
 };
 
-Scheduler* scheduler = nullptr;
-bool CALL_SCHEDULER = false;
+class PRIO final : public PrioScheduler {
+    public:
+        // initialise quantum
+        PRIO(int quantum, int max_prio) : PrioScheduler(quantum, max_prio) {}
 
+        bool does_preempt() {
+            return false;
+        }
+};
 
-// -------------------------------------------------------------------------------------------------------------- //
+// same queues as PRIO, but a process becoming ready may preempt a lower priority running process
+class PREPRIO final : public PrioScheduler {
+    public:
+        // initialise quantum
+        PREPRIO(int quantum, int max_prio) : PrioScheduler(quantum, max_prio) {}
 
-Process* CURRENT_RUNNING_PROCESS = nullptr;
+        bool does_preempt() {
+            return true;
+        }
+};
 
-int Simulation() {
-    
-    Event* event;
-    // while eventQ has events
-    while (event = des.get_Event()) {
-        // extract relevant event information
-        Process* current_process = event->process;
-        CURRENT_TIME = event->time_stamp;
-        int transition = event->get_transition();
-        // calculate duration of time spent in process's previous state for accounting
-        int timeInPrevState = CURRENT_TIME - current_process->state_ts;
-        // set new state entry time
-        current_process->state_ts = CURRENT_TIME;
-
-        if (verbose) {
-            cout << CURRENT_TIME << " " << current_process->pid << " " << timeInPrevState << ": " << States[event->old_state] << " -> " << States[event->new_state];
-        }
-
-        delete event;
-        event = nullptr;
-        Event new_event;
-
-        // switch based on transition
-        switch (transition) {
-            // if process is transitioning to READY state
-            case TRANS_TO_READY:
-
-                if (verbose) {
-                    cout << " cb=" << current_process->cpu_burst << " rem=" << current_process->remaining_cpu_time << " prio=" << current_process->dynamic_prio << endl;
-                }
-
-                // must come from BLOCKED or CREATED
-                // add to run queue, no event created
-
-                // reset dynamic priority
-                current_process->dynamic_prio = current_process->static_prio - 1;
-
-                // if preemptive priority scheduler then we check if we need to preempt a lower priority current running process
-                if (scheduler->does_preempt()) {
-                    if  ((CURRENT_RUNNING_PROCESS != nullptr) && (current_process->dynamic_prio > CURRENT_RUNNING_PROCESS->dynamic_prio)) {
-                        if (des.remove_event_at_different_time(CURRENT_RUNNING_PROCESS)) {
-                            // add new event for preemption
-                            new_event = Event(CURRENT_TIME, CURRENT_RUNNING_PROCESS, RUNNING, READY);
-                            des.add_Event(new_event);
-                        }
-                    }
-                }
-                
-                // add process to runQ
-                scheduler->add_process(current_process);
-                CALL_SCHEDULER = true;
-                break;
+struct DeadlineEntry {
+    int key;
+    int pid;
+    long seq;
+};
 
-            // if process is being preempted
-            case TRANS_TO_PREEMPT:
+// real-time schedulers: the ready process with the smallest key runs and a process with a smaller key becoming
+// ready preempts the running one; processes that are not periodic have the largest key and run in the background
+class DeadlineScheduler : public Scheduler {
+    public:
+        // run queue, maintained as a binary min-heap on (key, seq)
+        vector<DeadlineEntry> readyQ;
+        long next_seq = 0;
+
+        // initialise quantum
+        DeadlineScheduler(int quantum) {
+            this->quantum = quantum;
+        }
+        static bool later(const DeadlineEntry& a, const DeadlineEntry& b) {
+            if (a.key != b.key) {
+                return a.key > b.key;
+            }
+            return a.seq > b.seq;
+        }
+        virtual int key(const Process* p) = 0;
+        void reserve(int count) {
+            readyQ.reserve(count);
+        }
+        void add_process(Process *p) {
+            readyQ.push_back({key(p), p->pid, next_seq++});
+            push_heap(readyQ.begin(), readyQ.end(), later);
+        }
+        Process* get_next_process() {
+            Process* p = nullptr;
+            if (!readyQ.empty()) {
+                pop_heap(readyQ.begin(), readyQ.end(), later);
+                p = &table[readyQ.back().pid];
+                readyQ.pop_back();
+            }
+            return p;
+        }
+        void save_queue(vector<Process*>& queue, vector<long long>& state) {
+            vector<DeadlineEntry> entries = readyQ;
+            sort(entries.begin(), entries.end(), [](const DeadlineEntry& a, const DeadlineEntry& b) { return later(b, a); });
+            for (const auto& entry : entries) {
+                queue.push_back(&table[entry.pid]);
+            }
+        }
+        bool does_preempt() {
+            return true;
+        }
+        bool preempts(Process* p, Process* running) {
+            return key(p) < key(running);
+        }
+};
 
-                // must come from RUNNING (preemption)
-                // add to runqueue (no event is generated)
+// earliest deadline first: keyed by the absolute deadline of the current job
+class EDF final : public DeadlineScheduler {
+    public:
+        EDF(int quantum) : DeadlineScheduler(quantum) {}
 
-                // calculate remaining cpu time (total cpu time - timeInPrevState)
-                current_process->remaining_cpu_time = current_process->remaining_cpu_time - timeInPrevState;
+        int key(const Process* p) {
+            return p->deadline_ts;
+        }
+};
 
-                // decrement cpu burst
-                current_process->cpu_burst = current_process->cpu_burst - timeInPrevState;
-                
-                if (verbose) {
-                    cout << " cb=" << current_process->cpu_burst << " rem=" << current_process->remaining_cpu_time << " prio=" << current_process->dynamic_prio << endl;
-                }
+// rate monotonic: fixed priorities, keyed by period
+class RM final : public DeadlineScheduler {
+    public:
+        RM(int quantum) : DeadlineScheduler(quantum) {}
 
-                // decrement dynamic priority
-                current_process->dynamic_prio--;
+        int key(const Process* p) {
+            return (p->period > 0) ? p->period : INT_MAX;
+        }
+};
 
-                // add process to runQ
-                scheduler->add_process(current_process);
-                CURRENT_RUNNING_PROCESS = nullptr;
-                CALL_SCHEDULER = true;
-                break;
+// multi-level feedback queue: a process starts at the top level and drops a level once it used up the allotment of
+// its level, counted across all its runs there so that giving up the cpu just before the quantum expires does not
+// keep it on top. Each level has its own quantum, all levels are PrioArray queues (O(1) enqueue and pick), and
+// every boost_period all processes go back to the top level so long running ones do not starve. The boost is lazy:
+// queued processes are moved with one splice per level, and each process resets its own level the next time it is
+// seen in a later boost period
+class MLFQ final : public Scheduler {
+    public:
+        PrioArray* levelQ; // MLFQ level l is PrioArray level num_levels - 1 - l
+        vector<int> quanta;
+        vector<int> allotments;
+        int boost_period;
+        const int* clock; // current simulation time
+        int epoch = 0;
+        long boosts = 0;
+        long promoted = 0; // processes moved up by a boost
+        vector<long> level_time; // cpu time run at each level
 
-            // if process is transitioning to RUNNING state
-            case TRANS_TO_RUN:
+        MLFQ(const vector<int>& quanta, int boost_period, int allotment, const int* clock) {
+            this->quanta = quanta;
+            this->boost_period = boost_period;
+            this->clock = clock;
+            this->quantum = quanta[0];
+            for (int q : quanta) {
+                allotments.push_back(allotment*q);
+            }
+            levelQ = new PrioArray(quanta.size());
+            level_time.assign(quanta.size(), 0);
+        }
 
-                // create event for either preemption or blocking
+        ~MLFQ() {
+            delete levelQ;
+        }
 
-                if (verbose) {
-                    cout << " cb=" << current_process->cpu_burst << " rem=" << current_process->remaining_cpu_time << " prio=" << current_process->dynamic_prio << endl;
+        int num_levels() {
+            return quanta.size();
+        }
+        // start the boost periods that passed since the last call
+        void boost() {
+            if (boost_period <= 0) {
+                return;
+            }
+            int now_epoch = *clock/boost_period;
+            if (now_epoch == epoch) {
+                return;
+            }
+            boosts = boosts + (now_epoch - epoch);
+            epoch = now_epoch;
+            int top = num_levels() - 1;
+            for (int level = top - 1; level >= 0; level--) {
+                if (!levelQ->levels[level].empty()) {
+                    levelQ->levels[top].splice(levelQ->levels[top].end(), levelQ->levels[level]);
+                    levelQ->occupied.clear(level);
+                    levelQ->occupied.set(top);
                 }
-
-                // decide whether to add event for blocking or preemption
-                if (current_process->cpu_burst <= scheduler->quantum) {
-                    new_event = Event(CURRENT_TIME + current_process->cpu_burst, current_process, RUNNING, BLOCKED); // event for blocking
-                } else {
-                    new_event = Event(CURRENT_TIME + scheduler->quantum, current_process, RUNNING, READY); // event for preemption
+            }
+        }
+        // bring the level of process p up to date with the boosts it missed
+        void refresh(Process* p) {
+            if (p->mlfq_epoch != epoch) {
+                if (p->mlfq_level > 0) {
+                    promoted++;
                 }
+                p->mlfq_level = 0;
+                p->mlfq_used = 0;
+                p->mlfq_epoch = epoch;
+            }
+        }
+        int level_of(const Process* p) {
+            return (p->mlfq_epoch != epoch) ? 0 : p->mlfq_level;
+        }
+        void add_process(Process *p) {
+            boost();
+            refresh(p);
+            levelQ->push_back(p->pid, num_levels() - 1 - p->mlfq_level);
+        }
+        Process* get_next_process() {
+            boost();
+            return lookup(levelQ->pop_highest());
+        }
+        bool does_preempt() {
+            return true;
+        }
+        // a process becoming ready on a higher level takes the cpu
+        bool preempts(Process* p, Process* running) {
+            boost();
+            return level_of(p) < level_of(running);
+        }
+        // the quantum of the level, cut short by what is left of the allotment
+        int time_slice(Process* p) {
+            boost();
+            refresh(p);
+            int slice = quanta[p->mlfq_level];
+            if (p->mlfq_level < num_levels() - 1) {
+                slice = min(slice, allotments[p->mlfq_level] - p->mlfq_used);
+            }
+            return slice;
+        }
+        void account_run(Process* p, int run_time) {
+            boost();
+            refresh(p);
+            level_time[p->mlfq_level] += run_time;
+            if (p->mlfq_level < num_levels() - 1) {
+                p->mlfq_used = p->mlfq_used + run_time;
+                if (p->mlfq_used >= allotments[p->mlfq_level]) {
+                    p->mlfq_level++;
+                    p->mlfq_used = 0;
+                }
+            }
+        }
+        // top level first, state holds the boost period and counters
+        void save_queue(vector<Process*>& queue, vector<long long>& state) {
+            for (int level = num_levels() - 1; level >= 0; level--) {
+                append(queue, levelQ->levels[level]);
+            }
+            state.push_back(epoch);
+            state.push_back(boosts);
+            state.push_back(promoted);
+            state.insert(state.end(), level_time.begin(), level_time.end());
+        }
+        // processes go back to the level they were queued at (a process that missed a boost was moved to the top)
+        void restore_queue(const vector<Process*>& queue, const vector<long long>& state) {
+            if (state.size() == 3 + level_time.size()) {
+                epoch = state[0];
+                boosts = state[1];
+                promoted = state[2];
+                for (int level = 0; level < num_levels(); level++) {
+                    level_time[level] = state[3 + level];
+                }
+                for (Process* p : queue) {
+                    levelQ->push_back(p->pid, num_levels() - 1 - level_of(p));
+                }
+                return;
+            }
+            Scheduler::restore_queue(queue, state);
+        }
+};
 
-                // update cpu waiting time
-                current_process->cpu_waiting_time = current_process->cpu_waiting_time + timeInPrevState;
-
-                // add event to eventQ
-                des.add_Event(new_event);
-                break;
+// most frequency states a machine can be configured with
+const int MAX_FREQ_STATES = 8;
 
-            // if process is transitioning to BLOCKED state
-            case TRANS_TO_BLOCK:
+// cpu object: each simulated cpu runs one process at a time, picked from its own run queue
+struct CPU {
+    Scheduler* scheduler;
+    Process* running; // process dispatched to this cpu, nullptr if idle
+    int run_ts; // time the running process enters RUNNING, later than dispatch if it had to migrate
+    int queued; // number of processes in this cpu's run queue
+    int busy_time;
+    int steals;
+    int migrations;
+    int last_pid; // process this cpu ran last, -1 if none
+    long switches; // dispatches of a process other than the last one
+    long switch_time; // time spent switching context
+    long cache_time; // time spent refilling caches
+    int freq_state; // frequency state the governor picked for the running process
+    double util; // recent utilization seen by the governor, decayed at every decision
+    int util_ts; // time and busy time of the last governor decision
+    int util_busy;
+    long state_time[MAX_FREQ_STATES]; // time spent running in each frequency state
 
-                // create event for when process becomes READY again
+    CPU(Scheduler* scheduler) : scheduler(scheduler), running(nullptr), run_ts(0), queued(0), busy_time(0), steals(0), migrations(0), last_pid(-1), switches(0), switch_time(0), cache_time(0), freq_state(0), util(0.0), util_ts(0), util_busy(0), state_time() {}
 
-                // calculate remaining cpu time (total cpu time - timeInPrevState)
-                current_process->remaining_cpu_time = current_process->remaining_cpu_time - timeInPrevState;
-                current_process->cpu_burst = current_process->cpu_burst - timeInPrevState;
+    // number of processes assigned to this cpu
+    int load() {
+        return queued + ((running != nullptr) ? 1 : 0);
+    }
+};
 
-                // if remaining cpu time is 0, then process terminates
-                if (current_process->remaining_cpu_time == 0) {
-                    // set finishing time
-                    current_process->finishing_time = CURRENT_TIME;
-                    // calculate turnaround time
-                    current_process->turnaround_time = current_process->finishing_time - current_process->arrival_time;
-                    if (verbose) {
-                        cout << " Done" << endl;
-                    }
-                } else {
-                    // otherwise we create event for BLOCKING to READY
-                    current_process->set_io_burst();
-                    // keep track of number of processes currently performing IO
-                    num_performing_IO++;
-                    if (num_performing_IO == 1) {
-                        // if at least one process performing IO then measure IO time
-                        time_of_IO_start = CURRENT_TIME;
-                    }
+// modeled io device: serves one request at a time and queues the rest, picking the next one first in first out
+// (F), by shortest seek from the current head position (S) or in elevator order (L), as in iosched.cpp
+struct IODevice {
+    char discipline;
+    PidList queue; // pids of the queued requests, indexing table
+    Process* table = nullptr;
+    Process* active = nullptr; // request in service, nullptr if idle
+    int head = 0; // track the head is on
+    int direction = 1; // LOOK sweep direction: 1 towards higher tracks, 0 towards lower ones
+    long busy_time = 0;
+    long requests = 0;
+    long total_wait = 0; // time requests spent queued before service
+    long max_wait = 0;
+    long total_seek = 0; // tracks moved
 
-                    if (verbose) {
-                        cout << " ib=" << current_process->io_burst << " rem=" << current_process->remaining_cpu_time << endl;
-                    }
+    IODevice(char discipline) : discipline(discipline) {}
 
-                    // update process's total IO time
-                    current_process->total_io_time = current_process->total_io_time + current_process->io_burst;
-                    // add event for BLOCKING to READY transition
-                    new_event = Event(CURRENT_TIME + current_process->io_burst, current_process, BLOCKED, READY);
-                    des.add_Event(new_event);
+    // remove and return the next request to serve
+    Process* fetch() {
+        PidList::iterator min_it = queue.begin();
+        if (discipline == 'S') {
+            // shortest seek time first, earliest request on ties
+            for (auto it = queue.begin(); it != queue.end(); advance(it, 1)) {
+                if (abs(head - track_of(*it)) < abs(head - track_of(*min_it))) {
+                    min_it = it;
                 }
-
-                // no current running process
-                CURRENT_RUNNING_PROCESS = nullptr;
-                CALL_SCHEDULER = true;
-                break;
-        }
-
-        // if we need to schedule a new process to run
-        if (CALL_SCHEDULER) {
-            // process all events at current time stamp at once
-            if (des.get_next_event_time() == CURRENT_TIME) {
-                continue;
             }
-            CALL_SCHEDULER = false;
-            
-            if (CURRENT_RUNNING_PROCESS == nullptr) {
-                // get next process from scheduler
-                CURRENT_RUNNING_PROCESS = scheduler->get_next_process();
-                // if no processes to schedule then continue
-                if (CURRENT_RUNNING_PROCESS == nullptr) {
-                    continue;
-                }
-                
-                // update process's cpu burst
-                if (CURRENT_RUNNING_PROCESS->cpu_burst == 0) {
-                    CURRENT_RUNNING_PROCESS->set_cpu_burst();
-                    if (CURRENT_RUNNING_PROCESS->cpu_burst > CURRENT_RUNNING_PROCESS->remaining_cpu_time) {
-                        CURRENT_RUNNING_PROCESS->cpu_burst = CURRENT_RUNNING_PROCESS->remaining_cpu_time;
+        } else if (discipline == 'L') {
+            // nearest request in the sweep direction, turning around when there is none
+            bool found = false;
+            for (int pass = 0; (pass < 2) && !found; pass++) {
+                for (auto it = queue.begin(); it != queue.end(); advance(it, 1)) {
+                    if ((head == track_of(*it)) || ((head < track_of(*it)) == direction)) {
+                        if (!found || (abs(head - track_of(*it)) < abs(head - track_of(*min_it)))) {
+                            min_it = it;
+                            found = true;
+                        }
                     }
                 }
-
-                // add event to start running
-                Event event = Event(CURRENT_TIME, CURRENT_RUNNING_PROCESS, READY, RUNNING);
-                des.add_Event(event);                
+                if (!found) {
+                    direction = 1 - direction;
+                }
             }
         }
+        Process* p = &table[*min_it];
+        queue.erase(min_it);
+        return p;
     }
 
-    // at end of simulation, return finishing time of last process
-    return CURRENT_TIME;
-}
+    int track_of(int pid) const {
+        return table[pid].io_track;
+    }
+};
 
-// -------------------------------------------------------------------------------------------------------------- //
+// one traced state transition, also the fixed size record of the binary trace format
+struct TraceRecord {
+    int32_t time;
+    int32_t pid;
+    int32_t time_in_prev_state;
+    int32_t burst; // cpu burst, or io burst when blocking
+    int32_t rem; // remaining cpu time
+    int32_t prio; // dynamic priority
+    uint8_t old_state;
+    uint8_t new_state;
+    uint8_t done; // process finished on this transition
+    uint8_t unused;
+};
 
-int myrandom(int burst) {
-    // returns number between 1 and burst
-    int randval = randvals[ofs];
-    ofs++;
-    if (ofs > num_random_numbers-1) {
-        ofs = 0;
+// binary trace files start with this header
+const char TRACE_MAGIC[8] = {'S', 'C', 'H', 'E', 'D', 'T', 'R', '1'};
+
+// format a transition exactly as verbose output prints it, return length of the line
+int format_trace_line(const TraceRecord& rec, char* line, int size) {
+    int len = snprintf(line, size, "%d %d %d: %s -> %s", rec.time, rec.pid, rec.time_in_prev_state, States[rec.old_state].c_str(), States[rec.new_state].c_str());
+    if (rec.done) {
+        len += snprintf(line + len, size - len, " Done\n");
+    } else if (rec.new_state != BLOCKED) {
+        len += snprintf(line + len, size - len, " cb=%d rem=%d prio=%d\n", rec.burst, rec.rem, rec.prio);
+    } else {
+        len += snprintf(line + len, size - len, " ib=%d rem=%d\n", rec.burst, rec.rem);
     }
-    return 1 + (randval % burst);
+    return len;
 }
 
+// trace writer: collects transitions in a buffer and writes it out in large blocks, either as verbose text lines
+// or as binary trace records
+class TraceWriter {
+    public:
+        FILE* out;
+        bool binary;
+        vector<char> buffer;
+        size_t used = 0;
 
-int main(int argc, char* argv[]) {
+        TraceWriter(FILE* out, bool binary) : out(out), binary(binary), buffer(1 << 16) {
+            if (binary) {
+                fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), out);
+            }
+        }
 
-    bool got_s = false;
-    int quantum;
-    max_prio = 4;
-    int c;
-    string scheduler_name;
-    char scheduler_symbol;
-    // read flags
-    while ((c = getopt (argc, argv, "vs:")) != -1) {
-        switch (c) {
-            case 'v':
+        ~TraceWriter() {
+            flush();
+        }
+
+        void write(const TraceRecord& rec) {
+            // leave room for the longest possible text line
+            if (used + 128 > buffer.size()) {
+                flush();
+            }
+            if (binary) {
+                memcpy(&buffer[used], &rec, sizeof(rec));
+                used = used + sizeof(rec);
+            } else {
+                used = used + format_trace_line(rec, &buffer[used], 128);
+            }
+        }
+
+        void flush() {
+            if (used > 0) {
+                fwrite(&buffer[0], 1, used, out);
+                used = 0;
+            }
+            fflush(out);
+        }
+};
+
+// decode a binary trace file back into verbose text on stdout
+bool decode_trace(const char* path) {
+    FILE* in = fopen(path, "rb");
+    if (in == nullptr) {
+        cerr << "Error: failed to open trace file " << path << endl;
+        return false;
+    }
+    char magic[sizeof(TRACE_MAGIC)];
+    if ((fread(magic, 1, sizeof(magic), in) != sizeof(magic)) || (memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0)) {
+        cerr << "Error: not a trace file " << path << endl;
+        fclose(in);
+        return false;
+    }
+    TraceWriter text(stdout, false);
+    TraceRecord rec;
+    while (fread(&rec, sizeof(rec), 1, in) == 1) {
+        text.write(rec);
+    }
+    fclose(in);
+    return true;
+}
+
+// -------------------------------------------------------------------------------------------------------------- //
+
+// scheduler configuration, as given to -s
+struct SchedulerSpec {
+    char symbol;
+    int quantum;
+    int max_prio;
+    int target_latency; // CFS only
+    int min_granularity; // CFS only
+    vector<int> quanta; // MLFQ only: quantum of each level, from the top
+    int boost_period; // MLFQ only
+    int allotment; // MLFQ only: quanta a process may use at a level before it drops
+    string name;
+
+    SchedulerSpec() : symbol('F'), quantum(10000), max_prio(4), target_latency(24), min_granularity(3), boost_period(1000), allotment(1), name("FCFS") {}
+
+    // same policy with the same parameters; the name is derived from them
+    bool same_policy(const SchedulerSpec& other) const {
+        return (symbol == other.symbol) && (quantum == other.quantum) && (max_prio == other.max_prio) && (target_latency == other.target_latency) && (min_granularity == other.min_granularity) && (quanta == other.quanta) && (boost_period == other.boost_period) && (allotment == other.allotment);
+    }
+};
+
+// dvfs frequency state: cpu frequency, in any unit, and power drawn while running at it
+struct FrequencyState {
+    int frequency;
+    double power;
+};
+
+// machine configuration shared by every simulation of a run
+struct MachineSpec {
+    char engine; // event queue engine
+    int num_cpus;
+    int migration_cost; // delay before a process that changed cpu starts running
+    int cache_affinity; // a process that left its cpu less than this long ago is cache-hot and is queued there again
+    int num_devices; // modeled io devices, 0 for unlimited io parallelism
+    char io_discipline; // F (FIFO), S (SSTF) or L (LOOK)
+    int io_tracks; // tracks per device, each request goes to a random one
+    int seek_speed; // tracks the head moves per time unit
+    int switch_cost; // time to switch the cpu to another process
+    int cache_refill; // time to refill the caches for a process whose working set was evicted
+    int cache_window; // time off the cpu after which a process's working set is fully evicted
+    vector<FrequencyState> freq_states; // dvfs states by increasing frequency, empty when cpus always run at full speed
+    char governor; // dvfs governor: P (performance), W (powersave), O (ondemand) or U (schedutil)
+    double idle_power; // power drawn by an idle cpu
+
+    MachineSpec() : engine('L'), num_cpus(1), migration_cost(0), cache_affinity(0), num_devices(0), io_discipline('F'), io_tracks(100), seek_speed(10), switch_cost(0), cache_refill(0), cache_window(1000), governor('U'), idle_power(0.0) {}
+
+    bool switch_overhead() const {
+        return (switch_cost > 0) || (cache_refill > 0);
+    }
+
+    bool dvfs() const {
+        return !freq_states.empty();
+    }
+
+    // same frequency states, governor and idle power
+    bool same_dvfs(const MachineSpec& other) const {
+        bool same = (freq_states.size() == other.freq_states.size()) && (governor == other.governor) && (idle_power == other.idle_power);
+        for (int i = 0; same && (i < (int) freq_states.size()); i++) {
+            same = (freq_states[i].frequency == other.freq_states[i].frequency) && (freq_states[i].power == other.freq_states[i].power);
+        }
+        return same;
+    }
+};
+
+// parse a scheduler spec such as "E4:8", return false on unknown scheduler
+bool parse_scheduler_spec(const char* arg, SchedulerSpec& spec) {
+    spec = SchedulerSpec();
+    spec.symbol = arg[0];
+    switch (spec.symbol) {
+        case 'F':
+            spec.name = "FCFS";
+            break;
+        case 'L':
+            spec.name = "LCFS";
+            break;
+        case 'S':
+            spec.name = "SRTF";
+            break;
+        case 'R':
+            // extract quantum and max priority
+            sscanf(arg + 1, "%d:%d", &spec.quantum, &spec.max_prio);
+            spec.name = "RR " + to_string(spec.quantum);
+            // overwrite max priority to 4
+            spec.max_prio = 4;
+            break;
+        case 'P':
+            // extract quantum and max priority
+            sscanf(arg + 1, "%d:%d", &spec.quantum, &spec.max_prio);
+            spec.name = "PRIO " + to_string(spec.quantum);
+            break;
+        case 'E':
+            // extract quantum and max priority
+            sscanf(arg + 1, "%d:%d", &spec.quantum, &spec.max_prio);
+            spec.name = "PREPRIO " + to_string(spec.quantum);
+            break;
+        case 'T':
+            // extract quantum and max priority
+            sscanf(arg + 1, "%d:%d", &spec.quantum, &spec.max_prio);
+            spec.name = "LOTTERY " + to_string(spec.quantum);
+            break;
+        case 'D':
+            // extract quantum and max priority
+            sscanf(arg + 1, "%d:%d", &spec.quantum, &spec.max_prio);
+            spec.name = "STRIDE " + to_string(spec.quantum);
+            break;
+        case 'X':
+            // optional quantum
+            spec.name = "EDF";
+            if (sscanf(arg + 1, "%d", &spec.quantum) == 1) {
+                spec.name = spec.name + " " + to_string(spec.quantum);
+            }
+            break;
+        case 'M':
+            // optional quantum
+            spec.name = "RM";
+            if (sscanf(arg + 1, "%d", &spec.quantum) == 1) {
+                spec.name = spec.name + " " + to_string(spec.quantum);
+            }
+            break;
+        case 'Q': {
+            // extract comma separated level quanta, boost period and allotment; a single quantum q gives max_prio
+            // levels with quanta doubling from q
+            const char* p = arg + 1;
+            int q;
+            int length;
+            while (sscanf(p, "%d%n", &q, &length) == 1) {
+                if (q < 1) {
+                    return false;
+                }
+                spec.quanta.push_back(q);
+                p = p + length;
+                if (*p != ',') {
+                    break;
+                }
+                p++;
+            }
+            if (*p == ':') {
+                sscanf(p + 1, "%d:%d", &spec.boost_period, &spec.allotment);
+            }
+            if (spec.allotment < 1) {
+                return false;
+            }
+            if (spec.quanta.size() <= 1) {
+                q = spec.quanta.empty() ? 10 : spec.quanta[0];
+                spec.quanta.clear();
+                for (int level = 0; level < spec.max_prio; level++) {
+                    spec.quanta.push_back(q << level);
+                }
+            }
+            spec.quantum = spec.quanta[0];
+            spec.name = "MLFQ";
+            for (int level = 0; level < (int) spec.quanta.size(); level++) {
+                spec.name = spec.name + ((level == 0) ? " " : ",") + to_string(spec.quanta[level]);
+            }
+            spec.name = spec.name + ":" + to_string(spec.boost_period);
+            break;
+        }
+        case 'C':
+            // extract target latency, minimum granularity and max priority
+            sscanf(arg + 1, "%d:%d:%d", &spec.target_latency, &spec.min_granularity, &spec.max_prio);
+            if ((spec.target_latency < 1) || (spec.min_granularity < 1)) {
+                return false;
+            }
+            spec.name = "CFS " + to_string(spec.target_latency) + ":" + to_string(spec.min_granularity);
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+// parse a dvfs spec such as "800@2,1600@5.5,2400@11:O:0.5" (frequency@power states, governor, idle power) into
+// machine, return false if it is malformed
+bool parse_frequency_spec(const char* arg, MachineSpec& machine) {
+    machine.freq_states.clear();
+    const char* p = arg;
+    while (true) {
+        FrequencyState state;
+        int length;
+        if ((sscanf(p, "%d@%lf%n", &state.frequency, &state.power, &length) != 2) || (state.frequency < 1) || (state.power < 0.0)) {
+            return false;
+        }
+        machine.freq_states.push_back(state);
+        p = p + length;
+        if (*p != ',') {
+            break;
+        }
+        p++;
+    }
+    if (*p == ':') {
+        p++;
+        machine.governor = *p;
+        if ((machine.governor == '\0') || !strchr("PWOU", machine.governor)) {
+            return false;
+        }
+        p++;
+        if ((*p == ':') && ((sscanf(p + 1, "%lf", &machine.idle_power) != 1) || (machine.idle_power < 0.0))) {
+            return false;
+        }
+    }
+    sort(machine.freq_states.begin(), machine.freq_states.end(), [](const FrequencyState& a, const FrequencyState& b) { return a.frequency < b.frequency; });
+    return machine.freq_states.size() <= MAX_FREQ_STATES;
+}
+
+// create a new scheduler object for the given scheduler spec
+Scheduler* create_scheduler(const SchedulerSpec& spec, RandomStream* random, const int* clock) {
+    switch (spec.symbol) {
+        case 'L':
+            return new LCFS();
+        case 'S':
+            return new SRTF();
+        case 'R':
+            return new RR(spec.quantum);
+        case 'P':
+            return new PRIO(spec.quantum, spec.max_prio);
+        case 'E':
+            return new PREPRIO(spec.quantum, spec.max_prio);
+        case 'C':
+            return new CFS(spec.target_latency, spec.min_granularity);
+        case 'T':
+            return new LOTTERY(spec.quantum, random);
+        case 'D':
+            return new STRIDE(spec.quantum);
+        case 'X':
+            return new EDF(spec.quantum);
+        case 'M':
+            return new RM(spec.quantum);
+        case 'Q':
+            return new MLFQ(spec.quanta, spec.boost_period, spec.allotment, clock);
+        default:
+            return new FCFS();
+    }
+}
+
+// create a new event queue engine for the given engine symbol
+DES* create_des(char engine) {
+    if (engine == 'H') {
+        return new HeapDES();
+    }
+    return new ListDES();
+}
+
+// -------------------------------------------------------------------------------------------------------------- //
+
+// read-only memory mapping of a whole input file
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    int fd = -1;
+
+    // map file at path, return false if it can't be opened
+    bool open(const char* path) {
+        fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            return false;
+        }
+        size = st.st_size;
+        // an empty file can't be mapped but is still a valid (empty) input
+        if (size == 0) {
+            return true;
+        }
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        madvise(addr, size, MADV_SEQUENTIAL);
+        data = (const char*) addr;
+        return true;
+    }
+
+    ~MappedFile() {
+        if (data != nullptr) {
+            munmap((void*) data, size);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+};
+
+// parse one integer at p the way operator>> does: skip whitespace, optional sign, then digits;
+// advance p past it and return false if there is no integer before end or it doesn't fit in an int
+bool parse_int(const char*& p, const char* end, int& value) {
+    while ((p < end) && ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r') || (*p == '\v') || (*p == '\f'))) {
+        p++;
+    }
+    bool negative = false;
+    if ((p < end) && ((*p == '-') || (*p == '+'))) {
+        negative = (*p == '-');
+        p++;
+    }
+    if ((p >= end) || (*p < '0') || (*p > '9')) {
+        return false;
+    }
+    long long result = 0;
+    while ((p < end) && (*p >= '0') && (*p <= '9')) {
+        result = result*10 + (*p - '0');
+        if (result > 2147483648LL) {
+            return false;
+        }
+        p++;
+    }
+    if (negative) {
+        result = -result;
+    }
+    if ((result > 2147483647LL) || (result < -2147483648LL)) {
+        return false;
+    }
+    value = (int) result;
+    return true;
+}
+
+// parse the process on the input line [p, line_end) into process, return false if the line is malformed
+bool parse_process_line(const char* p, const char* line_end, ProcessAccounting& process) {
+    int arrival_time, total_cpu_time, max_cpu_burst, max_io_burst;
+    if (!(parse_int(p, line_end, arrival_time) && parse_int(p, line_end, total_cpu_time) && parse_int(p, line_end, max_cpu_burst) && parse_int(p, line_end, max_io_burst))) {
+        return false;
+    }
+    process = ProcessAccounting(arrival_time, total_cpu_time, max_cpu_burst, max_io_burst);
+    // optional fifth number gives the process's tickets for lottery and stride scheduling
+    int tickets;
+    if (parse_int(p, line_end, tickets)) {
+        process.tickets = tickets;
+        // optional sixth and seventh numbers make the process periodic, with one job per cpu burst released every
+        // period and due its relative deadline (default the period) after release
+        int period, deadline;
+        if (parse_int(p, line_end, period) && (period > 0)) {
+            process.period = period;
+            process.relative_deadline = period;
+            if (parse_int(p, line_end, deadline) && (deadline > 0)) {
+                process.relative_deadline = deadline;
+            }
+        }
+    }
+    return true;
+}
+
+// input file read one process at a time, for runs that admit arrivals as the simulation reaches them instead of
+// loading the whole workload. Pages already read are handed back to the kernel, so the mapping doesn't stay resident
+struct ArrivalStream {
+    static const size_t RELEASE_BYTES = 1 << 20;
+
+    MappedFile input_file;
+    const char* cursor = nullptr; // start of the next line
+    const char* end = nullptr;
+    const char* released = nullptr; // pages before this are no longer resident
+    int next_pid = 0; // input line of next
+    bool pending = false; // next holds a process that has not arrived yet
+    ProcessAccounting next;
+    RandomStream prio_random; // static priorities, drawn in input order as load draws them
+    double periodic_utilization = 0.0; // of the processes admitted so far
+
+    // map the input file and check that it can be streamed: every line well formed and arrival times in input
+    // order, so arriving in input order is arriving in time order. Sets num_processes, leaves next unread
+    bool open(const char* path, int& num_processes) {
+        if (!input_file.open(path)) {
+            return false;
+        }
+        const char* p = input_file.data;
+        end = p + input_file.size;
+        released = p;
+        num_processes = 0;
+        int last_arrival = INT_MIN;
+        while (p < end) {
+            const char* line_end = line_end_of(p);
+            ProcessAccounting process;
+            if (!parse_process_line(p, line_end, process) || (process.arrival_time < last_arrival)) {
+                return false;
+            }
+            last_arrival = process.arrival_time;
+            num_processes++;
+            p = line_end + 1;
+            release_before(p);
+        }
+        release_before(end);
+        cursor = input_file.data;
+        released = cursor;
+        return true;
+    }
+
+    // read the next process into next, pending is false once the input is exhausted
+    void advance() {
+        pending = (cursor < end);
+        if (!pending) {
+            return;
+        }
+        const char* line_end = line_end_of(cursor);
+        parse_process_line(cursor, line_end, next);
+        next_pid++;
+        cursor = line_end + 1;
+        release_before(cursor);
+    }
+
+    const char* line_end_of(const char* p) {
+        const char* line_end = (const char*) memchr(p, '\n', end - p);
+        return (line_end != nullptr) ? line_end : end;
+    }
+
+    // drop the whole pages before p from the resident set, once there is a megabyte of them
+    void release_before(const char* p) {
+        if ((size_t) (min(p, end) - released) < RELEASE_BYTES) {
+            return;
+        }
+        uintptr_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t first = (uintptr_t) released & ~(page - 1);
+        uintptr_t last = (uintptr_t) min(p, end) & ~(page - 1);
+        if (last > first) {
+            madvise((void*) first, last - first, MADV_DONTNEED);
+        }
+        released = (const char*) last;
+    }
+};
+
+// -------------------------------------------------------------------------------------------------------------- //
+
+// checkpoint file: raw host layout, so a snapshot is read back by the same build of the simulator
+const char CHECKPOINT_MAGIC[8] = {'S', 'C', 'H', 'E', 'D', 'C', 'K', '3'};
+
+struct SnapshotFile {
+    FILE* file;
+    bool ok = true; // cleared by the first failed read or write
+
+    template<typename T>
+    void put(const T& value) {
+        ok = ok && (fwrite(&value, sizeof(T), 1, file) == 1);
+    }
+
+    template<typename T>
+    void get(T& value) {
+        ok = ok && (fread(&value, sizeof(T), 1, file) == 1);
+    }
+
+    template<typename T>
+    void put_vector(const vector<T>& values) {
+        long count = values.size();
+        put(count);
+        ok = ok && ((count == 0) || (fwrite(values.data(), sizeof(T), count, file) == (size_t) count));
+    }
+
+    template<typename T>
+    void get_vector(vector<T>& values) {
+        long count = 0;
+        get(count);
+        // refuse counts that could not come from a real simulation
+        if (!ok || (count < 0) || (count > INT32_MAX)) {
+            ok = false;
+            return;
+        }
+        values.resize(count);
+        ok = ok && ((count == 0) || (fread(values.data(), sizeof(T), count, file) == (size_t) count));
+    }
+};
+
+// queued event as stored in a checkpoint
+struct SavedEvent {
+    int32_t time_stamp;
+    int32_t pid;
+    uint8_t old_state;
+    uint8_t new_state;
+};
+
+// log-linear histogram of non-negative times in the style of HdrHistogram: values below SUB_BUCKETS are counted
+// exactly and larger values with SUB_BITS significant bits (under 1% error), so percentiles of any number of samples
+// come from a fixed amount of memory
+struct LatencyHistogram {
+    static const int SUB_BITS = 8;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int HALF_BUCKETS = SUB_BUCKETS/2;
+    static const int NUM_BUCKETS = (31 - SUB_BITS + 2)*HALF_BUCKETS;
+
+    long counts[NUM_BUCKETS] = {};
+    long count = 0;
+    int max_value = 0;
+
+    static int bucket_of(int value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        // keep the top SUB_BITS bits of the value
+        int shift = (31 - __builtin_clz(value)) - (SUB_BITS - 1);
+        return shift*HALF_BUCKETS + (value >> shift);
+    }
+
+    // largest value counted in a bucket
+    static int highest_in_bucket(int bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        int shift = bucket/HALF_BUCKETS - 1;
+        int mantissa = bucket - shift*HALF_BUCKETS;
+        return (int) ((((long) mantissa + 1) << shift) - 1);
+    }
+
+    void record(int value) {
+        counts[bucket_of(max(value, 0))]++;
+        count++;
+        max_value = max(max_value, value);
+    }
+
+    // value at or below which the given percent of samples fall
+    int percentile(double percent) {
+        long rank = (long) ceil(percent/100.0*count);
+        rank = max(rank, 1L);
+        long seen = 0;
+        for (int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+            seen = seen + counts[bucket];
+            if (seen >= rank) {
+                return min(highest_in_bucket(bucket), max_value);
+            }
+        }
+        return max_value;
+    }
+};
+
+// simulation context: all state of one simulation run, so that several runs can share a loaded workload and
+// execute side by side on different threads
+class SimulationContext {
+    public:
+        SchedulerSpec spec;
+        MachineSpec machine;
+
+        // trace outputs, nullptr when not tracing
+        TraceWriter* text_trace = nullptr;
+        TraceWriter* binary_trace = nullptr;
+
+        vector<Process> processes;
+        vector<ProcessAccounting> accounting; // indexed by pid, like processes
+        DES* des = nullptr;
+        vector<CPU> cpus;
+        vector<IODevice> devices; // empty when io is not modeled
+        FastModulus io_track_mod; // reciprocal of machine.io_tracks
+
+        RandomStream random;
+        int CURRENT_TIME = 0;
+        int num_performing_IO = 0;
+        int time_of_IO_start = 0;
+        int time_of_IO_end = 0;
+        int total_IO_time = 0;
+        bool CALL_SCHEDULER = false;
+        long num_events = 0;
+        int final_time = 0;
+        double share_clock = 0.0; // cumulative cpu time each runnable ticket was entitled to
+        long long runnable_tickets = 0;
+        int share_ts = 0;
+
+        // streaming statistics, recorded as each process finishes so the report does not need per process rows
+        bool summary_only = false; // report percentiles instead of per process lines
+        long num_finished = 0;
+        long total_cpubusy = 0;
+        long total_turnaround = 0;
+        long total_cpu_waiting = 0;
+        LatencyHistogram turnaround_hist;
+        LatencyHistogram waiting_hist;
+
+#ifdef SCHED_STATS
+        // event loop instrumentation
+        Log2Histogram eventq_depth; // sampled once per event
+        Log2Histogram runq_length; // sampled at every pick, before taking the process
+        Log2Histogram pick_cycles;
+        uint64_t transition_cycles[4] = {};
+        long transition_count[4] = {};
+        long preemptions = 0; // running processes preempted by a newly ready one; quantum expiries are not counted
+#endif
+        double fairness_sum = 0.0;
+        double fairness_sum_squares = 0.0;
+        double total_share_deviation = 0.0;
+        double max_share_deviation = 0.0;
+        long total_jobs = 0; // jobs of periodic processes
+        long total_deadline_misses = 0;
+        LatencyHistogram lateness_hist; // lateness of each job, early jobs counted as 0
+
+#ifdef SCHED_COROUTINES
+        // coroutine of each process with a phase script, indexed by pid; empty when no process has one
+        vector<ProcessBehavior> behaviors;
+#endif
+
+        // checkpoint to write once simulated time reaches checkpoint_time, nullptr when not checkpointing
+        const char* checkpoint_path = nullptr;
+        int checkpoint_time = 0;
+
+        // summary runs of a whole input file can admit arrivals from it as the simulation reaches them and reuse the
+        // slots of finished processes, so the tables only hold the processes alive at once; nullptr for a loaded run
+        ArrivalStream* arrivals = nullptr;
+        vector<int> free_slots; // slots of finished processes
+
+        SimulationContext(const SchedulerSpec& spec, const MachineSpec& machine) {
+            this->spec = spec;
+            this->machine = machine;
+            des = create_des(machine.engine);
+            // create one scheduler, and so one runQ, per cpu
+            for (int i = 0; i < machine.num_cpus; i++) {
+                cpus.push_back(CPU(create_scheduler(spec, &random, &CURRENT_TIME)));
+            }
+            for (int i = 0; i < machine.num_devices; i++) {
+                devices.push_back(IODevice(machine.io_discipline));
+            }
+            io_track_mod = FastModulus(machine.io_tracks);
+        }
+
+        ~SimulationContext() {
+            delete arrivals;
+            delete des;
+            for (int i = 0; i < (int) cpus.size(); i++) {
+                delete cpus[i].scheduler;
+            }
+        }
+
+        // contexts hand out pointers into processes, so they are never copied
+        SimulationContext(const SimulationContext&) = delete;
+        SimulationContext& operator=(const SimulationContext&) = delete;
+
+        // take a private copy of the workload, set up the process table with static priorities and queue arrival
+        // events
+        void load(const vector<ProcessAccounting>& workload) {
+            accounting = workload;
+            processes.reserve(workload.size());
+            for (int i = 0; i < (int) workload.size(); i++) {
+                processes.push_back(Process(i, workload[i]));
+                processes[i].static_prio = random.myrandom(spec.max_prio);
+                // without an explicit share, tickets follow static priority
+                if (processes[i].tickets <= 0) {
+                    processes[i].tickets = 100*processes[i].static_prio;
+                }
+                // the first job of a periodic process is released on arrival
+                if (processes[i].period > 0) {
+                    processes[i].deadline_ts = workload[i].arrival_time + workload[i].relative_deadline;
+                }
+            }
+            reserve_queues();
+            // create arrival events
+            for (int i = 0; i < (int) processes.size(); i++) {
+                des->add_Event(Event(workload[i].arrival_time, &processes[i], CREATED, READY));
+            }
+
+#ifdef SCHED_COROUTINES
+            if (!phase_scripts.empty()) {
+                behaviors.resize(processes.size());
+                for (const auto& script : phase_scripts) {
+                    behaviors[script.pid] = replay_phases(script);
+                }
+            }
+#endif
+        }
+
+        // stream the input file at path instead of loading it: false, leaving the context as it was, if the file
+        // can't be opened, has a malformed line or arrivals out of input order
+        bool stream(const char* path) {
+            ArrivalStream* stream = new ArrivalStream();
+            int num_processes;
+            if (!stream->open(path, num_processes)) {
+                delete stream;
+                return false;
+            }
+            // load draws every static priority before the first event and the bursts follow them
+            stream->prio_random = random;
+            for (int i = 0; i < num_processes; i++) {
+                random.next();
+            }
+            arrivals = stream;
+            arrivals->advance();
+            processes.reserve(min(num_processes, 1024));
+            accounting.reserve(processes.capacity());
+            reserve_queues();
+            return true;
+        }
+
+        // time of the next event, counting the next arrival of a streamed run
+        int next_event_time() {
+            int next_time = des->get_next_event_time();
+            if ((arrivals != nullptr) && arrivals->pending && ((next_time < 0) || (arrivals->next.arrival_time < next_time))) {
+                next_time = arrivals->next.arrival_time;
+            }
+            return next_time;
+        }
+
+        // arrival event of the next process of a streamed run once it is due, else an empty event. It goes ahead of
+        // queued events at the same time, as load queues every arrival before the first event
+        Event admit_arrival() {
+            int next_time = des->get_next_event_time();
+            if (!arrivals->pending || ((next_time >= 0) && (next_time < arrivals->next.arrival_time))) {
+                return Event();
+            }
+            int slot = take_slot();
+            // events cancelled before the slot's last process finished must stay stale
+            int event_gen = processes[slot].event_gen + 1;
+            processes[slot] = Process(slot, arrivals->next);
+            accounting[slot] = arrivals->next;
+            Process* p = &processes[slot];
+            p->id = arrivals->next_pid - 1;
+            p->event_gen = event_gen;
+            p->static_prio = arrivals->prio_random.myrandom(spec.max_prio);
+            if (p->tickets <= 0) {
+                p->tickets = 100*p->static_prio;
+            }
+            if (p->period > 0) {
+                p->deadline_ts = arrivals->next.arrival_time + arrivals->next.relative_deadline;
+                arrivals->periodic_utilization = arrivals->periodic_utilization + arrivals->next.max_cpu_burst/(double) p->period;
+            }
+            Event arrival(arrivals->next.arrival_time, p, CREATED, READY);
+            arrivals->advance();
+            return arrival;
+        }
+
+        // slot for a process of a streamed run: the last one freed, else a new one at the end of the table
+        int take_slot() {
+            if (!free_slots.empty()) {
+                int slot = free_slots.back();
+                free_slots.pop_back();
+                // a cpu that last ran the slot's finished process has to switch to the new one
+                for (auto& cpu : cpus) {
+                    if (cpu.last_pid == slot) {
+                        cpu.last_pid = -1;
+                    }
+                }
+                return slot;
+            }
+            if (processes.size() == processes.capacity()) {
+                grow_table();
+            }
+            processes.push_back(Process());
+            accounting.push_back(ProcessAccounting());
+            return processes.size() - 1;
+        }
+
+        // double the room in the process table: it moves, so the running processes, the requests in service and
+        // the queues are pointed at the new one
+        void grow_table() {
+            vector<int> running;
+            for (const auto& cpu : cpus) {
+                running.push_back((cpu.running != nullptr) ? cpu.running->pid : -1);
+            }
+            vector<int> active;
+            for (const auto& device : devices) {
+                active.push_back((device.active != nullptr) ? device.active->pid : -1);
+            }
+            processes.reserve(2*processes.capacity());
+            accounting.reserve(processes.capacity());
+            for (int i = 0; i < (int) cpus.size(); i++) {
+                cpus[i].running = (running[i] >= 0) ? &processes[running[i]] : nullptr;
+            }
+            for (int i = 0; i < (int) devices.size(); i++) {
+                devices[i].active = (active[i] >= 0) ? &processes[active[i]] : nullptr;
+            }
+            reserve_queues();
+        }
+
+        // resume the behavior coroutine of process p up to its next request, false if p draws random bursts
+        bool next_request(Process* p, Request& request) {
+#ifdef SCHED_COROUTINES
+            if (behaviors.empty() || !behaviors[p->pid]) {
+                return false;
+            }
+            request = behaviors[p->pid].next();
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        // block process p for time units, on io or sleeping
+        void start_wait(Process* p, int time, bool io) {
+            p->io_burst = time;
+            p->in_io = io;
+            if (io) {
+                // keep track of number of processes currently performing IO
+                num_performing_IO++;
+                if (num_performing_IO == 1) {
+                    // if at least one process performing IO then measure IO time
+                    time_of_IO_start = CURRENT_TIME;
+                }
+                // with modeled devices the request queues at the process's device and is ready once served
+                if (!devices.empty()) {
+                    IODevice* device = device_of(p);
+                    p->io_track = random.myrandom(io_track_mod) - 1;
+                    p->io_submit_ts = CURRENT_TIME;
+                    if (device->active == nullptr) {
+                        start_io(device, p);
+                    } else {
+                        device->queue.push_back(p->pid);
+                    }
+                    return;
+                }
+                // update process's total IO time
+                p->total_io_time = p->total_io_time + p->io_burst;
+            }
+            // add event for BLOCKING to READY transition
+            des->add_Event(Event(CURRENT_TIME + p->io_burst, p, BLOCKED, READY));
+        }
+
+        // device serving process p, by its input line so a streamed run that reuses slots picks the same devices
+        IODevice* device_of(const Process* p) {
+            return &devices[p->id % devices.size()];
+        }
+
+        // serve the io request of process p: seek to its track, then transfer for its io burst
+        void start_io(IODevice* device, Process* p) {
+            int distance = abs(p->io_track - device->head);
+            int service_time = distance/machine.seek_speed + p->io_burst;
+            int wait = CURRENT_TIME - p->io_submit_ts;
+            device->active = p;
+            device->head = p->io_track;
+            device->requests++;
+            device->total_wait = device->total_wait + wait;
+            device->max_wait = max(device->max_wait, (long) wait);
+            device->total_seek = device->total_seek + distance;
+            device->busy_time = device->busy_time + service_time;
+            des->add_Event(Event(CURRENT_TIME + service_time, p, BLOCKED, READY));
+        }
+
+        // io request of process p is done: account the whole time it was blocked and serve the next request
+        void finish_io(Process* p) {
+            IODevice* device = device_of(p);
+            p->total_io_time = p->total_io_time + (CURRENT_TIME - p->io_submit_ts);
+            device->active = nullptr;
+            if (!device->queue.empty()) {
+                start_io(device, device->fetch());
+            }
+        }
+
+        // process p has ended
+        void finish(Process* p) {
+            ProcessAccounting& stats = accounting[p->pid];
+            // set finishing time
+            stats.finishing_time = CURRENT_TIME;
+            // calculate turnaround time
+            stats.turnaround_time = stats.finishing_time - stats.arrival_time;
+            record_finish(p);
+            if (arrivals != nullptr) {
+                free_slots.push_back(p->pid);
+            }
+        }
+
+        // the current job of periodic process p has completed: account its lateness and release the next job, one
+        // period after this one (so a process that overran its period has its next job released already)
+        void complete_job(Process* p) {
+            ProcessAccounting& stats = accounting[p->pid];
+            int lateness = CURRENT_TIME - p->deadline_ts;
+            stats.jobs++;
+            total_jobs++;
+            if (lateness > 0) {
+                stats.deadline_misses++;
+                total_deadline_misses++;
+            }
+            stats.max_lateness = max(stats.max_lateness, lateness);
+            lateness_hist.record(lateness);
+            p->release_ts = p->release_ts + p->period;
+            p->deadline_ts = p->release_ts + stats.relative_deadline;
+        }
+
+        // point the event queue, run queues and device queues at the process table and warm up their node pool: a
+        // process has at most one live event queued and the queue purges its cancelled events once they outnumber
+        // the processes, and a process sits in at most one run queue or device queue, so the simulation loop should
+        // not allocate
+        void reserve_queues() {
+            int capacity = processes.capacity();
+            des->track(processes.data(), capacity);
+            des->reserve(2*capacity);
+            for (int i = 0; i < (int) cpus.size(); i++) {
+                cpus[i].scheduler->table = processes.data();
+                cpus[i].scheduler->reserve(capacity);
+            }
+            for (auto& device : devices) {
+                device.table = processes.data();
+            }
+            PidList warmQ(capacity);
+        }
+
+        // proportional share accounting: every runnable ticket is entitled to an equal part of the cpus' time, so
+        // a single clock of entitlement per ticket is enough to give each process its entitled cpu time
+        bool proportional_share() {
+            return (spec.symbol == 'T') || (spec.symbol == 'D');
+        }
+
+        void advance_share_clock() {
+            if (runnable_tickets > 0) {
+                share_clock = share_clock + (CURRENT_TIME - share_ts)*(double) cpus.size()/runnable_tickets;
+            }
+            share_ts = CURRENT_TIME;
+        }
+
+        // choose the cpu run queue for a process becoming ready: stay on the last cpu while the process is cache-hot
+        // or that cpu is as lightly loaded as any other, otherwise move to the least loaded cpu
+        int select_cpu(Process* p) {
+            int best = 0;
+            for (int i = 1; i < (int) cpus.size(); i++) {
+                if (cpus[i].load() < cpus[best].load()) {
+                    best = i;
+                }
+            }
+            if (p->last_cpu < 0) {
+                return best;
+            }
+            if ((CURRENT_TIME - p->last_run_ts < machine.cache_affinity) || (cpus[p->last_cpu].load() <= cpus[best].load())) {
+                return p->last_cpu;
+            }
+            return best;
+        }
+
+        // return the cpu with the longest run queue, or -1 if every run queue is empty
+        int busiest_cpu() {
+            int busiest = -1;
+            for (int i = 0; i < (int) cpus.size(); i++) {
+                if ((cpus[i].queued > 0) && ((busiest < 0) || (cpus[i].queued > cpus[busiest].queued))) {
+                    busiest = i;
+                }
+            }
+            return busiest;
+        }
+
+        // write a transition to the enabled traces
+        void trace(const TraceRecord& rec) {
+            if (text_trace != nullptr) {
+                text_trace->write(rec);
+            }
+            if (binary_trace != nullptr) {
+                binary_trace->write(rec);
+            }
+        }
+
+        // dvfs governor: pick the frequency state for the next run on cpu from its utilization since the last pick
+        // (decayed by half every pick) and its run queue length, each queued process counting as a quarter of the
+        // cpu. Ondemand jumps to the top state above 80% load and steps down one state at a time below 30%;
+        // schedutil asks for 1.25 times the load times the current frequency, since the load is measured in wall
+        // clock time at whatever frequency the cpu ran (not frequency invariant); the others pin the top or bottom
+        // state
+        int governor_pick(CPU* cpu) {
+            int window = CURRENT_TIME - cpu->util_ts;
+            if (window > 0) {
+                cpu->util = (cpu->util + (cpu->busy_time - cpu->util_busy)/(double) window)/2;
+                cpu->util_ts = CURRENT_TIME;
+                cpu->util_busy = cpu->busy_time;
+            }
+            int top = machine.freq_states.size() - 1;
+            double load = min(1.0, cpu->util + 0.25*cpu->queued);
+            switch (machine.governor) {
+                case 'P':
+                    return top;
+                case 'W':
+                    return 0;
+                case 'O':
+                    if (load > 0.8) {
+                        return top;
+                    }
+                    return (load < 0.3) ? max(cpu->freq_state - 1, 0) : cpu->freq_state;
+            }
+            // lowest state at or above the target frequency
+            double target = 1.25*load*machine.freq_states[cpu->freq_state].frequency;
+            for (int i = 0; i < top; i++) {
+                if (machine.freq_states[i].frequency >= target) {
+                    return i;
+                }
+            }
+            return top;
+        }
+
+        // time cpu needs for work that takes work time units at the top frequency
+        int run_time(const CPU* cpu, int work) {
+            if (!machine.dvfs()) {
+                return work;
+            }
+            long long top = machine.freq_states.back().frequency;
+            long long frequency = machine.freq_states[cpu->freq_state].frequency;
+            return (int) ((work*top + frequency - 1)/frequency);
+        }
+
+        // part of its cpu burst process p got done running elapsed time units on cpu, when it is stopped before the
+        // end of the burst: at least one unit for any time it ran, so slow states still make progress
+        int work_done(const CPU* cpu, const Process* p, int elapsed) {
+            if (!machine.dvfs()) {
+                return elapsed;
+            }
+            long long top = machine.freq_states.back().frequency;
+            long long work = elapsed*(long long) machine.freq_states[cpu->freq_state].frequency/top;
+            work = max(work, (long long) ((elapsed > 0) ? 1 : 0));
+            return (int) min(work, (long long) max(p->cpu_burst - 1, 0));
+        }
+
+        // start running process p on cpu cpu_id
+        void dispatch(int cpu_id, Process* p) {
+            CPU* cpu = &cpus[cpu_id];
+            int start_time = CURRENT_TIME;
+            // a process moving to a different cpu pays the migration cost before it runs
+            if ((p->last_cpu >= 0) && (p->last_cpu != cpu_id)) {
+                cpu->migrations++;
+                start_time = start_time + machine.migration_cost;
+            }
+            // switching to another process costs a context switch, and the process then refills the part of its
+            // working set evicted since it last ran here: all of it after cache_window or on a cpu it did not run on
+            if (cpu->last_pid != p->pid) {
+                cpu->switches++;
+                cpu->switch_time = cpu->switch_time + machine.switch_cost;
+                start_time = start_time + machine.switch_cost;
+            }
+            if (machine.cache_refill > 0) {
+                int refill = machine.cache_refill;
+                if (p->last_cpu == cpu_id) {
+                    refill = (int) min((long) machine.cache_refill, (long) (CURRENT_TIME - p->last_run_ts)*machine.cache_refill/machine.cache_window);
+                }
+                cpu->cache_time = cpu->cache_time + refill;
+                start_time = start_time + refill;
+            }
+            cpu->last_pid = p->pid;
+            if (machine.dvfs()) {
+                cpu->freq_state = governor_pick(cpu);
+            }
+            p->cpu = cpu_id;
+            p->last_cpu = cpu_id;
+            cpu->running = p;
+            cpu->run_ts = start_time;
+
+            // update process's cpu burst
+            if (p->cpu_burst == 0) {
+                p->cpu_burst = random.myrandom(p->cpu_burst_mod);
+                if (p->cpu_burst > p->remaining_cpu_time) {
+                    p->cpu_burst = p->remaining_cpu_time;
+                }
+            }
+
+            // add event to start running
+            des->add_Event(Event(start_time, p, READY, RUNNING));
+        }
+
+        // take the next event off the queue, first writing the checkpoint once the next event reaches its time
+        Event next_event() {
+            if (arrivals != nullptr) {
+                Event arrival = admit_arrival();
+                if (arrival) {
+                    return arrival;
+                }
+            }
+            if ((checkpoint_path != nullptr) && (des->get_next_event_time() >= checkpoint_time)) {
+                if (!write_checkpoint(checkpoint_path)) {
+                    cerr << "Error: failed to write checkpoint " << checkpoint_path << endl;
+                }
+                checkpoint_path = nullptr;
+            }
+            return des->get_Event();
+        }
+
+        // write the whole simulation state between two events: scalars, the process table, each cpu with its run
+        // queue, the live events in queue order and the streaming statistics
+        bool write_checkpoint(const char* path) {
+#ifdef SCHED_COROUTINES
+            // a suspended coroutine can't be written out
+            if (!behaviors.empty()) {
+                return false;
+            }
+#endif
+            FILE* file = fopen(path, "wb");
+            if (file == nullptr) {
+                return false;
+            }
+            SnapshotFile snapshot = {file};
+            snapshot.put(CHECKPOINT_MAGIC);
+            snapshot.put(spec.symbol);
+            snapshot.put(spec.quantum);
+            snapshot.put(spec.max_prio);
+            snapshot.put(spec.target_latency);
+            snapshot.put(spec.min_granularity);
+            snapshot.put(spec.boost_period);
+            snapshot.put(spec.allotment);
+            snapshot.put_vector(spec.quanta);
+            snapshot.put((int) cpus.size());
+            snapshot.put_vector(machine.freq_states);
+            snapshot.put(machine.governor);
+            snapshot.put(machine.idle_power);
+            snapshot.put(builtin_random);
+            snapshot.put(random);
+            snapshot.put(CURRENT_TIME);
+            snapshot.put(num_performing_IO);
+            snapshot.put(time_of_IO_start);
+            snapshot.put(time_of_IO_end);
+            snapshot.put(total_IO_time);
+            snapshot.put(CALL_SCHEDULER);
+            snapshot.put(num_events);
+            snapshot.put(share_clock);
+            snapshot.put(runnable_tickets);
+            snapshot.put(share_ts);
+            snapshot.put(num_finished);
+            snapshot.put(total_cpubusy);
+            snapshot.put(total_turnaround);
+            snapshot.put(total_cpu_waiting);
+            snapshot.put(turnaround_hist);
+            snapshot.put(waiting_hist);
+            snapshot.put(fairness_sum);
+            snapshot.put(fairness_sum_squares);
+            snapshot.put(total_share_deviation);
+            snapshot.put(max_share_deviation);
+            snapshot.put(total_jobs);
+            snapshot.put(total_deadline_misses);
+            snapshot.put(lateness_hist);
+            snapshot.put_vector(processes);
+            snapshot.put_vector(accounting);
+
+            for (auto& cpu : cpus) {
+                snapshot.put((cpu.running != nullptr) ? cpu.running->pid : -1);
+                snapshot.put(cpu.run_ts);
+                snapshot.put(cpu.queued);
+                snapshot.put(cpu.busy_time);
+                snapshot.put(cpu.steals);
+                snapshot.put(cpu.migrations);
+                snapshot.put(cpu.last_pid);
+                snapshot.put(cpu.switches);
+                snapshot.put(cpu.switch_time);
+                snapshot.put(cpu.cache_time);
+                snapshot.put(cpu.freq_state);
+                snapshot.put(cpu.util);
+                snapshot.put(cpu.util_ts);
+                snapshot.put(cpu.util_busy);
+                snapshot.put(cpu.state_time);
+                vector<Process*> queue;
+                vector<long long> state;
+                cpu.scheduler->save_queue(queue, state);
+                vector<int> pids;
+                for (Process* p : queue) {
+                    pids.push_back(p->pid);
+                }
+                snapshot.put_vector(pids);
+                snapshot.put_vector(state);
+            }
+
+            vector<Event> events;
+            des->live_events(events);
+            vector<SavedEvent> saved;
+            for (const auto& event : events) {
+                saved.push_back({event.time_stamp, event.pid, event.old_state, event.new_state});
+            }
+            snapshot.put_vector(saved);
+            return (fclose(file) == 0) && snapshot.ok;
+        }
+
+        // replace the state of a freshly constructed context with a checkpoint taken on the same workload; the
+        // checkpoint may come from another scheduler, whose run queues are then refilled in their saved order
+        bool restore_checkpoint(const char* path, const vector<ProcessAccounting>& workload) {
+            FILE* file = fopen(path, "rb");
+            if (file == nullptr) {
+                cerr << "Error: failed to open checkpoint " << path << endl;
+                return false;
+            }
+            SnapshotFile snapshot = {file};
+            char magic[sizeof(CHECKPOINT_MAGIC)];
+            SchedulerSpec saved_spec;
+            int num_cpus;
+            snapshot.get(magic);
+            snapshot.get(saved_spec.symbol);
+            snapshot.get(saved_spec.quantum);
+            snapshot.get(saved_spec.max_prio);
+            snapshot.get(saved_spec.target_latency);
+            snapshot.get(saved_spec.min_granularity);
+            snapshot.get(saved_spec.boost_period);
+            snapshot.get(saved_spec.allotment);
+            snapshot.get_vector(saved_spec.quanta);
+            snapshot.get(num_cpus);
+            if (!snapshot.ok || (memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0)) {
+                cerr << "Error: not a checkpoint file " << path << endl;
+                fclose(file);
+                return false;
+            }
+            if (num_cpus != (int) cpus.size()) {
+                cerr << "Error: checkpoint was taken with " << num_cpus << " cpus" << endl;
+                fclose(file);
+                return false;
+            }
+            // residency and energy are kept per frequency state, so the states must be the same
+            MachineSpec saved_machine;
+            snapshot.get_vector(saved_machine.freq_states);
+            snapshot.get(saved_machine.governor);
+            snapshot.get(saved_machine.idle_power);
+            if (snapshot.ok && !machine.same_dvfs(saved_machine)) {
+                cerr << "Error: checkpoint was taken with other -f frequency states" << endl;
+                fclose(file);
+                return false;
+            }
+            bool builtin;
+            snapshot.get(builtin);
+            if (snapshot.ok && (builtin != builtin_random)) {
+                cerr << "Error: checkpoint was taken with " << (builtin ? "-r" : "a random file") << endl;
+                fclose(file);
+                return false;
+            }
+            snapshot.get(random);
+            snapshot.get(CURRENT_TIME);
+            snapshot.get(num_performing_IO);
+            snapshot.get(time_of_IO_start);
+            snapshot.get(time_of_IO_end);
+            snapshot.get(total_IO_time);
+            snapshot.get(CALL_SCHEDULER);
+            snapshot.get(num_events);
+            snapshot.get(share_clock);
+            snapshot.get(runnable_tickets);
+            snapshot.get(share_ts);
+            snapshot.get(num_finished);
+            snapshot.get(total_cpubusy);
+            snapshot.get(total_turnaround);
+            snapshot.get(total_cpu_waiting);
+            snapshot.get(turnaround_hist);
+            snapshot.get(waiting_hist);
+            snapshot.get(fairness_sum);
+            snapshot.get(fairness_sum_squares);
+            snapshot.get(total_share_deviation);
+            snapshot.get(max_share_deviation);
+            snapshot.get(total_jobs);
+            snapshot.get(total_deadline_misses);
+            snapshot.get(lateness_hist);
+            snapshot.get_vector(processes);
+            snapshot.get_vector(accounting);
+            if (!snapshot.ok) {
+                cerr << "Error: truncated or corrupt checkpoint " << path << endl;
+                fclose(file);
+                return false;
+            }
+
+            // the checkpoint must belong to this workload
+            bool same_workload = (processes.size() == workload.size()) && (accounting.size() == workload.size());
+            for (int i = 0; same_workload && (i < (int) accounting.size()); i++) {
+                same_workload = (accounting[i].arrival_time == workload[i].arrival_time) && (accounting[i].total_cpu_time == workload[i].total_cpu_time) && (accounting[i].max_cpu_burst == workload[i].max_cpu_burst) && (accounting[i].max_io_burst == workload[i].max_io_burst);
+            }
+            if (!same_workload) {
+                cerr << "Error: checkpoint does not match input file" << endl;
+                fclose(file);
+                return false;
+            }
+            reserve_queues();
+
+            // new run queues only understand state saved by an identically configured scheduler
+            bool same_scheduler = spec.same_policy(saved_spec);
+            bool tickets_changed = false;
+            if (!same_scheduler) {
+                // priorities and mlfq levels drawn under another spec must fit the ranges of this one, tickets
+                // that follow static priority follow the clamped one
+                int bottom_level = max((int) spec.quanta.size() - 1, 0);
+                for (int i = 0; i < (int) processes.size(); i++) {
+                    Process& p = processes[i];
+                    p.static_prio = min(max(p.static_prio, 1), spec.max_prio);
+                    p.dynamic_prio = min(max(p.dynamic_prio, -1), p.static_prio - 1);
+                    if ((accounting[i].tickets <= 0) && (p.tickets != 100*p.static_prio)) {
+                        p.tickets = 100*p.static_prio;
+                        tickets_changed = true;
+                    }
+                    p.mlfq_level = min(max(p.mlfq_level, 0), bottom_level);
+                    p.mlfq_used = 0;
+                }
+            }
+            for (auto& cpu : cpus) {
+                int running_pid;
+                vector<int> pids;
+                vector<long long> state;
+                snapshot.get(running_pid);
+                snapshot.get(cpu.run_ts);
+                snapshot.get(cpu.queued);
+                snapshot.get(cpu.busy_time);
+                snapshot.get(cpu.steals);
+                snapshot.get(cpu.migrations);
+                snapshot.get(cpu.last_pid);
+                snapshot.get(cpu.switches);
+                snapshot.get(cpu.switch_time);
+                snapshot.get(cpu.cache_time);
+                snapshot.get(cpu.freq_state);
+                snapshot.get(cpu.util);
+                snapshot.get(cpu.util_ts);
+                snapshot.get(cpu.util_busy);
+                snapshot.get(cpu.state_time);
+                snapshot.get_vector(pids);
+                snapshot.get_vector(state);
+                if (!snapshot.ok || !valid_pid(running_pid, true)) {
+                    break;
+                }
+                cpu.running = (running_pid >= 0) ? &processes[running_pid] : nullptr;
+                vector<Process*> queue;
+                for (int pid : pids) {
+                    snapshot.ok = snapshot.ok && valid_pid(pid, false);
+                    if (snapshot.ok) {
+                        queue.push_back(&processes[pid]);
+                    }
+                }
+                if (!same_scheduler) {
+                    state.clear();
+                }
+                cpu.scheduler->restore_queue(queue, state);
+            }
+
+            vector<SavedEvent> saved;
+            snapshot.get_vector(saved);
+            for (int i = 0; snapshot.ok && (i < (int) saved.size()); i++) {
+                snapshot.ok = valid_pid(saved[i].pid, false);
+                if (snapshot.ok) {
+                    des->add_Event(Event(saved[i].time_stamp, &processes[saved[i].pid], (State) saved[i].old_state, (State) saved[i].new_state));
+                }
+            }
+            fclose(file);
+            if (!snapshot.ok) {
+                cerr << "Error: truncated or corrupt checkpoint " << path << endl;
+                return false;
+            }
+
+            // switching to a proportional share scheduler: start entitlement accounting for every runnable process;
+            // coming from one, only the ticket total is recomputed when tickets were re-derived
+            bool start_share = (saved_spec.symbol != 'T') && (saved_spec.symbol != 'D');
+            if (!same_scheduler && proportional_share() && (start_share || tickets_changed)) {
+                runnable_tickets = 0;
+                if (start_share) {
+                    share_ts = CURRENT_TIME;
+                }
+                for (auto& cpu : cpus) {
+                    vector<Process*> queue;
+                    vector<long long> state;
+                    cpu.scheduler->save_queue(queue, state);
+                    if (cpu.running != nullptr) {
+                        queue.push_back(cpu.running);
+                    }
+                    for (Process* p : queue) {
+                        runnable_tickets = runnable_tickets + p->tickets;
+                        if (start_share) {
+                            accounting[p->pid].share_start = share_clock;
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool valid_pid(int pid, bool allow_none) {
+            return (allow_none && (pid == -1)) || ((pid >= 0) && (pid < (int) processes.size()));
+        }
+
+        // process p becomes ready: add it to the run queue of the cpu it is placed on, preempting that cpu's running
+        // process if the policy says so
+        template <typename SchedulerT>
+        void join_run_queue(Process* p) {
+            // process joins the runnable set: start accruing its entitlement
+            if (proportional_share()) {
+                advance_share_clock();
+                runnable_tickets = runnable_tickets + p->tickets;
+                accounting[p->pid].share_start = share_clock;
+            }
+
+            // reset dynamic priority
+            p->dynamic_prio = p->static_prio - 1;
+
+            // pick the cpu whose runQ the process joins
+            p->cpu = select_cpu(p);
+            CPU* cpu = &cpus[p->cpu];
+
+            // if preemptive priority scheduler then we check if we need to preempt a lower priority current running process
+            // (a process still paying its migration cost has not started running and is left alone)
+            if (static_cast<SchedulerT*>(cpu->scheduler)->does_preempt()) {
+                if  ((cpu->running != nullptr) && (cpu->run_ts <= CURRENT_TIME) && static_cast<SchedulerT*>(cpu->scheduler)->preempts(p, cpu->running)) {
+                    if (des->remove_event_at_different_time(cpu->running, CURRENT_TIME)) {
+                        STATS(preemptions++);
+                        // add new event for preemption
+                        des->add_Event(Event(CURRENT_TIME, cpu->running, RUNNING, READY));
+                    }
+                }
+            }
+
+            // add process to runQ
+            static_cast<SchedulerT*>(cpu->scheduler)->add_process(p);
+            cpu->queued++;
+            CALL_SCHEDULER = true;
+        }
+
+        // simulation loop, instantiated per scheduler class: for a final class the compiler resolves and inlines the
+        // runQ operations and drops the preemption check of non-preemptive policies; Simulation<Scheduler> is the
+        // generic loop that dispatches virtually
+        template <typename SchedulerT>
+        int Simulation() {
+    
+            Event event;
+            // while eventQ has events
+            while ((event = next_event())) {
+                num_events++;
+                STATS(uint64_t transition_start = read_cycles());
+                STATS(eventq_depth.record(des->depth));
+                // extract relevant event information
+                Process* current_process = &processes[event.pid];
+                CURRENT_TIME = event.time_stamp;
+                int transition = event.get_transition();
+                // calculate duration of time spent in process's previous state for accounting
+                int timeInPrevState = CURRENT_TIME - current_process->state_ts;
+                // set new state entry time
+                current_process->state_ts = CURRENT_TIME;
+
+                bool tracing = (text_trace != nullptr) || (binary_trace != nullptr);
+                TraceRecord rec = {CURRENT_TIME, current_process->pid, timeInPrevState, 0, 0, 0, event.old_state, event.new_state, 0, 0};
+
+                Event new_event;
+                CPU* cpu;
+                int quantum;
+                int work;
+                Request request;
+                bool programmed;
+
+                // switch based on transition
+                switch (transition) {
+                    // if process is transitioning to READY state
+                    case TRANS_TO_READY:
+
+                        // must come from BLOCKED or CREATED
+                        // add to run queue, no event created
+
+                        // mark end of io time if no processes are performing io: needed for tracking total io time
+                        if ((event.old_state == BLOCKED) && current_process->in_io) {
+                            current_process->in_io = false;
+                            if (!devices.empty()) {
+                                finish_io(current_process);
+                            }
+                            num_performing_IO--;
+                            if (num_performing_IO == 0) {
+                                time_of_IO_end = CURRENT_TIME;
+                                total_IO_time = total_IO_time + (time_of_IO_end - time_of_IO_start);
+                            }
+                        }
+
+                        // a programmed process asks for its next cpu burst: it may also wait again or be done
+                        if (current_process->cpu_burst == 0) {
+                            if (next_request(current_process, request)) {
+                                if ((request.kind == REQ_IO) || (request.kind == REQ_SLEEP)) {
+                                    // the process is ready and leaves for its wait at once: trace both hops, so the
+                                    // time it then spends blocked counts from here
+                                    if (tracing) {
+                                        rec.rem = current_process->remaining_cpu_time;
+                                        rec.prio = current_process->dynamic_prio;
+                                        trace(rec);
+                                        rec = {CURRENT_TIME, current_process->pid, 0, request.time, current_process->remaining_cpu_time, 0, READY, BLOCKED, 0, 0};
+                                        trace(rec);
+                                    }
+                                    start_wait(current_process, request.time, request.kind == REQ_IO);
+                                    break;
+                                }
+                                if (request.kind == REQ_DONE) {
+                                    accounting[current_process->pid].total_cpu_time = accounting[current_process->pid].total_cpu_time - current_process->remaining_cpu_time;
+                                    current_process->remaining_cpu_time = 0;
+                                    finish(current_process);
+                                    if (tracing) {
+                                        rec.done = 1;
+                                        trace(rec);
+                                    }
+                                    break;
+                                }
+                                current_process->cpu_burst = min(max(request.time, 1), current_process->remaining_cpu_time);
+                            }
+                        }
+
+                        if (tracing) {
+                            rec.burst = current_process->cpu_burst;
+                            rec.rem = current_process->remaining_cpu_time;
+                            rec.prio = current_process->dynamic_prio;
+                            trace(rec);
+                        }
+
+                        join_run_queue<SchedulerT>(current_process);
+                        break;
+
+                    // if process is being preempted
+                    case TRANS_TO_PREEMPT:
+
+                        // must come from RUNNING (preemption)
+                        // add to runqueue (no event is generated)
+
+                        // calculate remaining cpu time (total cpu time - work done in timeInPrevState)
+                        cpu = &cpus[current_process->cpu];
+                        work = work_done(cpu, current_process, timeInPrevState);
+                        current_process->remaining_cpu_time = current_process->remaining_cpu_time - work;
+
+                        // decrement cpu burst
+                        current_process->cpu_burst = current_process->cpu_burst - work;
+                        cpu->state_time[cpu->freq_state] += timeInPrevState;
+                
+                        if (tracing) {
+                            rec.burst = current_process->cpu_burst;
+                            rec.rem = current_process->remaining_cpu_time;
+                            rec.prio = current_process->dynamic_prio;
+                            trace(rec);
+                        }
+
+                        // decrement dynamic priority
+                        current_process->dynamic_prio--;
+
+                        // add process back to its cpu's runQ
+                        static_cast<SchedulerT*>(cpu->scheduler)->account_run(current_process, timeInPrevState);
+                        cpu->busy_time = cpu->busy_time + timeInPrevState;
+                        current_process->last_run_ts = CURRENT_TIME;
+                        static_cast<SchedulerT*>(cpu->scheduler)->add_process(current_process);
+                        cpu->queued++;
+                        cpu->running = nullptr;
+                        CALL_SCHEDULER = true;
+                        break;
+
+                    // if process is transitioning to RUNNING state
+                    case TRANS_TO_RUN:
+
+                        // create event for either preemption or blocking
+
+                        if (tracing) {
+                            rec.burst = current_process->cpu_burst;
+                            rec.rem = current_process->remaining_cpu_time;
+                            rec.prio = current_process->dynamic_prio;
+                            trace(rec);
+                        }
+
+                        // decide whether to add event for blocking or preemption
+                        // (the burst takes longer when the cpu runs below its top frequency)
+                        cpu = &cpus[current_process->cpu];
+                        quantum = static_cast<SchedulerT*>(cpu->scheduler)->time_slice(current_process);
+                        work = run_time(cpu, current_process->cpu_burst);
+                        if (work <= quantum) {
+                            new_event = Event(CURRENT_TIME + work, current_process, RUNNING, BLOCKED); // event for blocking
+                        } else {
+                            new_event = Event(CURRENT_TIME + quantum, current_process, RUNNING, READY); // event for preemption
+                        }
+
+                        // update cpu waiting time
+                        current_process->cpu_waiting_time = current_process->cpu_waiting_time + timeInPrevState;
+
+                        // add event to eventQ
+                        des->add_Event(new_event);
+                        break;
+
+                    // if process is transitioning to BLOCKED state
+                    case TRANS_TO_BLOCK:
+
+                        // create event for when process becomes READY again
+
+                        // calculate remaining cpu time (total cpu time - timeInPrevState): the whole burst is done, which took
+                        // timeInPrevState at the top frequency
+                        cpu = &cpus[current_process->cpu];
+                        work = machine.dvfs() ? current_process->cpu_burst : timeInPrevState;
+                        current_process->remaining_cpu_time = current_process->remaining_cpu_time - work;
+                        current_process->cpu_burst = current_process->cpu_burst - work;
+                        cpu->state_time[cpu->freq_state] += timeInPrevState;
+
+                        // process leaves the runnable set: collect the entitlement it accrued
+                        if (proportional_share()) {
+                            advance_share_clock();
+                            runnable_tickets = runnable_tickets - current_process->tickets;
+                            accounting[current_process->pid].entitled_cpu = accounting[current_process->pid].entitled_cpu + current_process->tickets*(share_clock - accounting[current_process->pid].share_start);
+                        }
+
+                        // a programmed process says what follows its cpu burst: a wait, another burst or its end
+                        programmed = (current_process->remaining_cpu_time > 0) && next_request(current_process, request);
+                        if (programmed && (request.kind == REQ_DONE)) {
+                            accounting[current_process->pid].total_cpu_time = accounting[current_process->pid].total_cpu_time - current_process->remaining_cpu_time;
+                            current_process->remaining_cpu_time = 0;
+                        }
+
+                        // each cpu burst of a periodic process is one job
+                        if (current_process->period > 0) {
+                            complete_job(current_process);
+                        }
+
+                        // if remaining cpu time is 0, then process terminates
+                        if (current_process->remaining_cpu_time == 0) {
+                            finish(current_process);
+                            if (tracing) {
+                                rec.done = 1;
+                                trace(rec);
+                            }
+                        } else if (programmed && (request.kind == REQ_CPU)) {
+                            // back to back bursts: the process goes straight back to the ready state, once its cpu
+                            // is released below
+                            current_process->cpu_burst = min(max(request.time, 1), current_process->remaining_cpu_time);
+                            if (tracing) {
+                                rec.new_state = READY;
+                                rec.burst = current_process->cpu_burst;
+                                rec.rem = current_process->remaining_cpu_time;
+                                rec.prio = current_process->dynamic_prio;
+                                trace(rec);
+                            }
+                        } else {
+                            // otherwise we create event for BLOCKING to READY
+                            int io_burst;
+                            bool io = !programmed || (request.kind == REQ_IO);
+                            if (!programmed && (current_process->period > 0)) {
+                                // a periodic process sleeps until its next job is released
+                                io_burst = max(current_process->release_ts - CURRENT_TIME, 0);
+                                io = false;
+                            } else if (!programmed) {
+                                io_burst = random.myrandom(current_process->io_burst_mod);
+                            } else {
+                                io_burst = request.time;
+                            }
+
+                            if (tracing) {
+                                rec.burst = io_burst;
+                                rec.rem = current_process->remaining_cpu_time;
+                                trace(rec);
+                            }
+
+                            start_wait(current_process, io_burst, io);
+                        }
+
+                        // no current running process on the cpu
+                        static_cast<SchedulerT*>(cpu->scheduler)->account_run(current_process, timeInPrevState);
+                        cpu->busy_time = cpu->busy_time + timeInPrevState;
+                        current_process->last_run_ts = CURRENT_TIME;
+                        cpu->running = nullptr;
+                        CALL_SCHEDULER = true;
+                        if (programmed && (request.kind == REQ_CPU) && (current_process->remaining_cpu_time > 0)) {
+                            join_run_queue<SchedulerT>(current_process);
+                        }
+                        break;
+                }
+                STATS(transition_cycles[transition] += read_cycles() - transition_start);
+                STATS(transition_count[transition]++);
+
+                // if we need to schedule a new process to run
+                if (CALL_SCHEDULER) {
+                    // process all events at current time stamp at once
+                    if (next_event_time() == CURRENT_TIME) {
+                        continue;
+                    }
+                    CALL_SCHEDULER = false;
+
+                    // idle cpus take the next process from their own runQ
+                    for (int i = 0; i < (int) cpus.size(); i++) {
+                        if (cpus[i].running == nullptr) {
+                            STATS(runq_length.record(cpus[i].queued));
+                            STATS(uint64_t pick_start = read_cycles());
+                            Process* p = static_cast<SchedulerT*>(cpus[i].scheduler)->get_next_process();
+                            STATS(pick_cycles.record(read_cycles() - pick_start));
+                            if (p != nullptr) {
+                                cpus[i].queued--;
+                                dispatch(i, p);
+                            }
+                        }
+                    }
+                    // cpus that are still idle steal the next process of the cpu with the longest runQ
+                    for (int i = 0; i < (int) cpus.size(); i++) {
+                        if (cpus[i].running == nullptr) {
+                            int victim = busiest_cpu();
+                            // if no processes to schedule then stop
+                            if (victim < 0) {
+                                break;
+                            }
+                            STATS(runq_length.record(cpus[victim].queued));
+                            STATS(uint64_t pick_start = read_cycles());
+                            Process* p = static_cast<SchedulerT*>(cpus[victim].scheduler)->get_next_process();
+                            STATS(pick_cycles.record(read_cycles() - pick_start));
+                            cpus[victim].queued--;
+                            cpus[i].steals++;
+                            dispatch(i, p);
+                        }
+                    }
+                }
+            }
+
+            // at end of simulation, return finishing time of last process
+            final_time = CURRENT_TIME;
+            return CURRENT_TIME;
+        }
+
+        // run the simulation loop instantiated for this run's scheduler, or the generic virtual dispatch loop
+        int run(bool specialized) {
+            if (!specialized) {
+                return Simulation<Scheduler>();
+            }
+            switch (spec.symbol) {
+                case 'L':
+                    return Simulation<LCFS>();
+                case 'S':
+                    return Simulation<SRTF>();
+                case 'R':
+                    return Simulation<RR>();
+                case 'P':
+                    return Simulation<PRIO>();
+                case 'E':
+                    return Simulation<PREPRIO>();
+                case 'C':
+                    return Simulation<CFS>();
+                case 'T':
+                    return Simulation<LOTTERY>();
+                case 'D':
+                    return Simulation<STRIDE>();
+                case 'X':
+                    return Simulation<EDF>();
+                case 'M':
+                    return Simulation<RM>();
+                case 'Q':
+                    return Simulation<MLFQ>();
+                default:
+                    return Simulation<FCFS>();
+            }
+        }
+
+        // fold a finished process into the streaming statistics
+        void record_finish(const Process* p) {
+            const ProcessAccounting& stats = accounting[p->pid];
+            num_finished++;
+            total_cpubusy = total_cpubusy + stats.total_cpu_time;
+            total_turnaround = total_turnaround + stats.turnaround_time;
+            total_cpu_waiting = total_cpu_waiting + p->cpu_waiting_time;
+            turnaround_hist.record(stats.turnaround_time);
+            waiting_hist.record(p->cpu_waiting_time);
+
+            // fairness: Jain's index over each process's cpu share while runnable (cpu time over cpu plus ready
+            // time, so io and idle time don't count) divided by its weight, 1.0 when every process got the cpu in
+            // exact proportion to its weight whenever it wanted it. Kept for every policy so they can be compared
+            long runnable_time = stats.total_cpu_time + (long) p->cpu_waiting_time;
+            if (runnable_time > 0) {
+                double share = (stats.total_cpu_time/(double) runnable_time)/cfs_weight(p->static_prio);
+                fairness_sum = fairness_sum + share;
+                fairness_sum_squares = fairness_sum_squares + share*share;
+            }
+            // proportional share: deviation of received cpu time from entitlement
+            if (proportional_share()) {
+                double deviation = fabs(share_deviation(stats));
+                total_share_deviation = total_share_deviation + deviation;
+                max_share_deviation = max(max_share_deviation, deviation);
+            }
+        }
+
+        // deviation of the cpu time a process received from its entitlement, in percent
+        double share_deviation(const ProcessAccounting& stats) {
+            if (stats.entitled_cpu <= 0.0) {
+                return 0.0;
+            }
+            return 100.0*(stats.total_cpu_time - stats.entitled_cpu)/stats.entitled_cpu;
+        }
+
+        // utilization of the periodic processes, taking the max cpu burst as the execution time of a job
+        double periodic_utilization() {
+            // a streamed run no longer has the rows of finished processes, it summed them as they arrived
+            if (arrivals != nullptr) {
+                return arrivals->periodic_utilization;
+            }
+            double utilization = 0.0;
+            for (const auto& stats : accounting) {
+                if (stats.period > 0) {
+                    utilization = utilization + stats.max_cpu_burst/(double) stats.period;
+                }
+            }
+            return utilization;
+        }
+
+        // schedulability analysis per process on one cpu, with the max cpu burst as worst case execution time: 'Y'
+        // or 'N' for periodic processes, '-' for the others. EDF uses the density test (sum of C/min(D, T) at most
+        // 1); RM uses response time analysis against the processes of shorter period; other policies give no
+        // guarantee. Only the first MAX_ANALYZED periodic processes are analyzed, the rest are marked '?'
+        void schedulability(vector<char>& verdict) {
+            const int MAX_ANALYZED = 10000;
+            verdict.assign(processes.size(), '-');
+            vector<int> periodic;
+            for (int pid = 0; pid < (int) accounting.size(); pid++) {
+                if (accounting[pid].period > 0) {
+                    if (periodic.size() < MAX_ANALYZED) {
+                        periodic.push_back(pid);
+                    } else {
+                        verdict[pid] = '?';
+                    }
+                }
+            }
+            if (spec.symbol == 'X') {
+                double density = 0.0;
+                for (int pid : periodic) {
+                    density = density + accounting[pid].max_cpu_burst/(double) min(accounting[pid].relative_deadline, accounting[pid].period);
+                }
+                for (int pid : periodic) {
+                    verdict[pid] = (density <= 1.0) ? 'Y' : 'N';
+                }
+            } else if (spec.symbol == 'M') {
+                for (int pid : periodic) {
+                    const ProcessAccounting& task = accounting[pid];
+                    // iterate R = C + sum over the other processes j with T_j <= T of ceil(R/T_j)*C_j to a fixed point
+                    // or past D (processes of equal period may run first, depending on arrival order)
+                    long response = task.max_cpu_burst;
+                    long previous = 0;
+                    while ((response != previous) && (response <= task.relative_deadline)) {
+                        previous = response;
+                        response = task.max_cpu_burst;
+                        for (int other : periodic) {
+                            const ProcessAccounting& higher = accounting[other];
+                            if ((other != pid) && (higher.period <= task.period)) {
+                                response = response + ((previous + higher.period - 1)/higher.period)*higher.max_cpu_burst;
+                            }
+                        }
+                    }
+                    verdict[pid] = (response <= task.relative_deadline) ? 'Y' : 'N';
+                }
+            }
+        }
+
+        // format the per process metrics and aggregate metrics of the finished simulation, handing each piece of
+        // text to emit so the report can be collected or hashed without holding it all
+        template<typename Sink>
+        void write_report(Sink emit) {
+            char line[256];
+            emit(spec.name.c_str());
+            emit("\n");
+
+            // real-time columns and summary when a real-time policy runs or the workload has periodic processes
+            bool realtime = (spec.symbol == 'X') || (spec.symbol == 'M') || (total_jobs > 0);
+            vector<char> schedulable;
+            if (realtime && !summary_only) {
+                schedulability(schedulable);
+            }
+
+            // print process metrics, unless only the summary was asked for
+            if (!summary_only) {
+                for (const auto& process : processes) {
+                    const ProcessAccounting& stats = accounting[process.pid];
+                    snprintf(line, sizeof(line), "%04d: %4d %4d %4d %4d %1d | %5d %5d %5d %5d", process.pid, stats.arrival_time, stats.total_cpu_time, stats.max_cpu_burst, stats.max_io_burst, process.static_prio, stats.finishing_time, stats.turnaround_time, process.total_io_time, process.cpu_waiting_time);
+                    emit(line);
+                    // CFS also reports final virtual runtime
+                    if (spec.symbol == 'C') {
+                        snprintf(line, sizeof(line), " %9.1lf", process.vruntime/1024.0);
+                        emit(line);
+                    }
+                    // proportional share schedulers also report tickets, entitled cpu time and deviation from it in percent
+                    if (proportional_share()) {
+                        snprintf(line, sizeof(line), " %5d %8.1lf %+7.2lf", process.tickets, stats.entitled_cpu, share_deviation(stats));
+                        emit(line);
+                    }
+                    // real-time: period, relative deadline, jobs, deadline misses, worst lateness and whether the
+                    // analysis says the process meets its deadlines
+                    if (realtime) {
+                        snprintf(line, sizeof(line), " %5d %5d %4d %4d %5d %c", process.period, stats.relative_deadline, stats.jobs, stats.deadline_misses, (stats.jobs > 0) ? stats.max_lateness : 0, schedulable[process.pid]);
+                        emit(line);
+                    }
+                    emit("\n");
+                }
+            }
+
+            // calculate simulation metrics from the streaming statistics
+            double cpu_util = 100.0*(total_cpubusy/((double) final_time*cpus.size()));
+            double io_util = 100.0*(total_IO_time/(double) final_time);
+            double throughput = 100.0*(num_finished/(double) final_time);
+            double avg_turnaround = ((double) total_turnaround)/((double) num_finished);
+            double avg_cpu_waiting = ((double) total_cpu_waiting)/((double) num_finished);
+
+            // print aggregate metrics
+            snprintf(line, sizeof(line), "SUM: %d %.2lf %.2lf %.2lf %.2lf %.3lf\n", final_time, cpu_util, io_util, avg_turnaround, avg_cpu_waiting, throughput);
+            emit(line);
+
+            // dvfs: energy of all cpus, idle included, its product with the finishing time, and the share of cpu time
+            // spent idle and in each frequency state
+            if (machine.dvfs()) {
+                double capacity = (double) final_time*cpus.size();
+                double energy = 0.0;
+                long running = 0;
+                string residency;
+                for (int s = 0; s < (int) machine.freq_states.size(); s++) {
+                    long state_time = 0;
+                    for (const auto& cpu : cpus) {
+                        state_time = state_time + cpu.state_time[s];
+                    }
+                    running = running + state_time;
+                    energy = energy + state_time*machine.freq_states[s].power;
+                    snprintf(line, sizeof(line), " %d=%.2lf", machine.freq_states[s].frequency, 100.0*(state_time/capacity));
+                    residency += line;
+                }
+                energy = energy + (capacity - running)*machine.idle_power;
+                snprintf(line, sizeof(line), "ENERGY: energy=%.1lf edp=%.4e avg_power=%.3lf\n", energy, energy*final_time, energy/final_time);
+                emit(line);
+                snprintf(line, sizeof(line), "FREQ: idle=%.2lf", 100.0*((capacity - running)/capacity));
+                emit(line);
+                emit(residency.c_str());
+                emit("\n");
+            }
+
+            // print per device metrics when io is modeled
+            for (int i = 0; i < (int) devices.size(); i++) {
+                const IODevice& device = devices[i];
+                snprintf(line, sizeof(line), "IO[%d]: util=%.2lf requests=%ld avg_wait=%.2lf max_wait=%ld avg_seek=%.2lf\n", i, 100.0*(device.busy_time/(double) final_time), device.requests, (device.requests > 0) ? device.total_wait/(double) device.requests : 0.0, device.max_wait, (device.requests > 0) ? device.total_seek/(double) device.requests : 0.0);
+                emit(line);
+            }
+
+            // print tail latencies in summary mode
+            if (summary_only) {
+                snprintf(line, sizeof(line), "PCT: turnaround p50=%d p90=%d p99=%d p999=%d max=%d\n", turnaround_hist.percentile(50), turnaround_hist.percentile(90), turnaround_hist.percentile(99), turnaround_hist.percentile(99.9), turnaround_hist.max_value);
+                emit(line);
+                snprintf(line, sizeof(line), "PCT: waiting p50=%d p90=%d p99=%d p999=%d max=%d\n", waiting_hist.percentile(50), waiting_hist.percentile(90), waiting_hist.percentile(99), waiting_hist.percentile(99.9), waiting_hist.max_value);
+                emit(line);
+            }
+
+            // CFS always reports it; other policies only in summary mode, keeping their default output as it was
+            if (((spec.symbol == 'C') || summary_only) && (fairness_sum_squares > 0.0)) {
+                snprintf(line, sizeof(line), "FAIRNESS: jain=%.4lf\n", (fairness_sum*fairness_sum)/(num_finished*fairness_sum_squares));
+                emit(line);
+            }
+
+            if (proportional_share()) {
+                snprintf(line, sizeof(line), "SHARE: avg_dev=%.2lf max_dev=%.2lf\n", total_share_deviation/num_finished, max_share_deviation);
+                emit(line);
+            }
+
+            if (realtime) {
+                snprintf(line, sizeof(line), "RT: jobs=%ld misses=%ld miss_rate=%.2lf lateness p50=%d p90=%d p99=%d max=%d utilization=%.3lf\n", total_jobs, total_deadline_misses, (total_jobs > 0) ? 100.0*total_deadline_misses/total_jobs : 0.0, lateness_hist.percentile(50), lateness_hist.percentile(90), lateness_hist.percentile(99), lateness_hist.max_value, periodic_utilization());
+                emit(line);
+            }
+
+            // MLFQ: boost periods, processes they promoted and cpu time run at each level
+            if (spec.symbol == 'Q') {
+                long boosts = 0;
+                long promoted = 0;
+                vector<long> level_time(spec.quanta.size(), 0);
+                for (const auto& cpu : cpus) {
+                    const MLFQ* mlfq = static_cast<const MLFQ*>(cpu.scheduler);
+                    boosts = max(boosts, mlfq->boosts);
+                    promoted = promoted + mlfq->promoted;
+                    for (int level = 0; level < (int) level_time.size(); level++) {
+                        level_time[level] = level_time[level] + mlfq->level_time[level];
+                    }
+                }
+                snprintf(line, sizeof(line), "MLFQ: boosts=%ld promoted=%ld", boosts, promoted);
+                emit(line);
+                for (int level = 0; level < (int) level_time.size(); level++) {
+                    snprintf(line, sizeof(line), " L%d=%ld", level, level_time[level]);
+                    emit(line);
+                }
+                emit("\n");
+            }
+
+            // switch overhead, when modeled: util counts the overhead as busy time, effective_util only the time
+            // processes ran (the SUM cpu utilization)
+            if (machine.switch_overhead()) {
+                long switches = 0;
+                long switch_time = 0;
+                long cache_time = 0;
+                for (const auto& cpu : cpus) {
+                    switches = switches + cpu.switches;
+                    switch_time = switch_time + cpu.switch_time;
+                    cache_time = cache_time + cpu.cache_time;
+                }
+                double capacity = (double) final_time*cpus.size();
+                snprintf(line, sizeof(line), "OVERHEAD: switches=%ld switch_time=%ld cache_time=%ld util=%.2lf effective_util=%.2lf\n", switches, switch_time, cache_time, 100.0*((total_cpubusy + switch_time + cache_time)/capacity), cpu_util);
+                emit(line);
+            }
+
+            // print per cpu metrics when simulating more than one cpu
+            if (cpus.size() > 1) {
+                for (int i = 0; i < (int) cpus.size(); i++) {
+                    snprintf(line, sizeof(line), "CPU[%d]: util=%.2lf steals=%d migrations=%d\n", i, 100.0*(cpus[i].busy_time/(double) final_time), cpus[i].steals, cpus[i].migrations);
+                    emit(line);
+                }
+            }
+        }
+
+        string report() {
+            string out;
+            write_report([&out](const char* text) { out += text; });
+            return out;
+        }
+
+#ifdef SCHED_STATS
+        // instrumentation counters of the finished simulation as a json object
+        string stats_json() {
+            long queue_swaps = 0;
+            for (auto& cpu : cpus) {
+                PrioScheduler* prio = dynamic_cast<PrioScheduler*>(cpu.scheduler);
+                if (prio != nullptr) {
+                    queue_swaps = queue_swaps + prio->queue_swaps;
+                }
+            }
+            string out = "{\"scheduler\":\"" + spec.name + "\",\"events\":" + to_string(num_events);
+            out += ",\"eventq_depth\":" + eventq_depth.json();
+            out += ",\"runq_length\":" + runq_length.json();
+            out += ",\"pick_cycles\":" + pick_cycles.json();
+            out += ",\"transitions\":{";
+            for (int t = 0; t < 4; t++) {
+                out += string((t > 0) ? "," : "") + "\"" + Transitions[t] + "\":{\"count\":" + to_string(transition_count[t]) + ",\"cycles\":" + to_string(transition_cycles[t]) + "}";
+            }
+            out += "},\"preemptions\":" + to_string(preemptions);
+            out += ",\"cancellations\":" + to_string(des->cancellations);
+            out += ",\"stale_events\":" + to_string(des->stale_events);
+            out += ",\"queue_swaps\":" + to_string(queue_swaps) + "}\n";
+            return out;
+        }
+#endif
+
+        // FNV-1a hash of the report, to compare runs without keeping their output
+        uint64_t report_digest() {
+            uint64_t hash = 14695981039346656037ULL;
+            write_report([&hash](const char* text) {
+                for (const char* c = text; *c != '\0'; c++) {
+                    hash = (hash ^ (unsigned char) *c)*1099511628211ULL;
+                }
+            });
+            return hash;
+        }
+};
+
+// -------------------------------------------------------------------------------------------------------------- //
+
+// run one simulation per scheduler spec over the same workload on a pool of threads, return reports in spec order
+vector<string> run_sweep(const vector<SchedulerSpec>& specs, const MachineSpec& machine, const vector<ProcessAccounting>& workload, int num_threads, bool summary_only) {
+    vector<string> reports(specs.size());
+    atomic<int> next_spec(0);
+
+    // each worker keeps taking the next configuration until all are done
+    auto worker = [&]() {
+        int i;
+        while ((i = next_spec++) < (int) specs.size()) {
+            SimulationContext context(specs[i], machine);
+            context.summary_only = summary_only;
+            context.load(workload);
+            context.run(true);
+            reports[i] = context.report();
+        }
+    };
+
+    vector<thread> pool;
+    for (int t = 0; t < num_threads; t++) {
+        pool.push_back(thread(worker));
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pool[t].join();
+    }
+    return reports;
+}
+
+// hardware last level cache miss counter for the calling thread, read as -1 where perf events are unavailable (no
+// linux, no pmu in a vm, or perf_event_paranoid too strict)
+class CacheMissCounter {
+    public:
+        int fd = -1;
+
+        CacheMissCounter() {
+#ifdef __linux__
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+        }
+
+        ~CacheMissCounter() {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        void start() {
+#ifdef __linux__
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        long long stop() {
+            long long count = -1;
+#ifdef __linux__
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                    count = -1;
+                }
+            }
+#endif
+            return count;
+        }
+};
+
+// peak resident set size of the process in KB since the last restart, read as -1 where the high-water mark can't
+// be restarted (no linux, or a kernel without clear_refs), since the process wide maximum would mix up the specs
+class PeakRssMeter {
+    public:
+        bool restarted = false;
+
+        void restart() {
+            restarted = false;
+#ifdef __linux__
+            int fd = open("/proc/self/clear_refs", O_WRONLY);
+            if (fd >= 0) {
+                restarted = (write(fd, "5", 1) == 1);
+                close(fd);
+            }
+#endif
+        }
+
+        long read_kb() {
+            long peak = -1;
+#ifdef __linux__
+            FILE* status = restarted ? fopen("/proc/self/status", "r") : nullptr;
+            if (status != nullptr) {
+                char line[256];
+                while ((peak < 0) && (fgets(line, sizeof(line), status) != nullptr)) {
+                    if (sscanf(line, "VmHWM: %ld", &peak) != 1) {
+                        peak = -1;
+                    }
+                }
+                fclose(status);
+            }
+#endif
+            return peak;
+        }
+};
+
+// benchmark one scheduler spec: time the selected engine with the per scheduler loop and check that its report is
+// byte-identical to a golden run of the generic loop on the golden engine, print one line
+bool benchmark_spec(const SchedulerSpec& spec, const MachineSpec& machine, const MachineSpec& golden_machine, const vector<ProcessAccounting>& workload) {
+    // measured run first, so no golden run has grown the heap before the peak is restarted
+    PeakRssMeter peak_rss;
+    peak_rss.restart();
+    SimulationContext context(spec, machine);
+    context.load(workload);
+    CacheMissCounter cache_misses;
+    long allocations_before = num_allocations;
+    chrono::steady_clock::time_point sim_start = chrono::steady_clock::now();
+    cache_misses.start();
+    context.run(true);
+    long long misses = cache_misses.stop();
+    chrono::steady_clock::time_point sim_end = chrono::steady_clock::now();
+    long sim_allocations = num_allocations - allocations_before;
+    long peak = peak_rss.read_kb();
+
+    // golden run, only its digest is kept
+    uint64_t golden_digest;
+    {
+        SimulationContext golden(spec, golden_machine);
+        golden.load(workload);
+        golden.run(false);
+        golden_digest = golden.report_digest();
+    }
+    bool match = (context.report_digest() == golden_digest);
+
+    char peak_rss_kb[32] = "n/a";
+    if (peak >= 0) {
+        snprintf(peak_rss_kb, sizeof(peak_rss_kb), "%ld", peak);
+    }
+    char misses_per_event[32] = "n/a";
+    if ((misses >= 0) && (context.num_events > 0)) {
+        snprintf(misses_per_event, sizeof(misses_per_event), "%.3lf", misses/(double) context.num_events);
+    }
+
+    double sim_ms = chrono::duration<double, milli>(sim_end - sim_start).count();
+    printf("%-16s events=%ld sim_ms=%.3lf events_per_sec=%.0lf ns_per_event=%.1lf allocs=%ld peak_rss_kb=%s cache_misses_per_event=%s golden=%s\n", spec.name.c_str(), context.num_events, sim_ms, (sim_ms > 0.0) ? 1e3*context.num_events/sim_ms : 0.0, (context.num_events > 0) ? 1e6*sim_ms/context.num_events : 0.0, sim_allocations, peak_rss_kb, misses_per_event, match ? "OK" : "DIFF");
+    fflush(stdout);
+    return match;
+}
+
+// benchmark every scheduler spec over one workload, one line per spec. Each spec runs in a child process of its
+// own: memory freed by one simulation stays in the heap, so in a shared process the peak resident set of every
+// spec would include what the specs before it left behind
+bool run_benchmark(const vector<SchedulerSpec>& specs, const MachineSpec& machine, char golden_engine, const vector<ProcessAccounting>& workload) {
+    MachineSpec golden_machine = machine;
+    golden_machine.engine = golden_engine;
+    bool all_match = true;
+
+    for (const auto& spec : specs) {
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            _exit(benchmark_spec(spec, machine, golden_machine, workload) ? 0 : 1);
+        }
+        bool match;
+        if (child < 0) {
+            match = benchmark_spec(spec, machine, golden_machine, workload);
+        } else {
+            int status = 0;
+            match = (waitpid(child, &status, 0) == child) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+        }
+        all_match = all_match && match;
+    }
+    return all_match;
+}
+
+// benchmark the sweep over all scheduler specs on 1, 2, 4, ... threads up to max_threads, checking the reports of
+// every sweep against the one thread sweep. The specs are independent simulations, so this is where threads speed
+// up a run without changing its results: the simulation of one machine is sequential, as every event may draw from
+// its random stream and place a process on any of its cpus
+bool run_sweep_benchmark(const vector<SchedulerSpec>& specs, const MachineSpec& machine, const vector<ProcessAccounting>& workload, int max_threads) {
+    vector<string> sequential_reports;
+    double sequential_ms = 0.0;
+    bool all_match = true;
+    for (int num_threads = 1; ; num_threads = min(2*num_threads, max_threads)) {
+        chrono::steady_clock::time_point sweep_start = chrono::steady_clock::now();
+        vector<string> reports = run_sweep(specs, machine, workload, num_threads, false);
+        chrono::steady_clock::time_point sweep_end = chrono::steady_clock::now();
+        double sweep_ms = chrono::duration<double, milli>(sweep_end - sweep_start).count();
+        if (num_threads == 1) {
+            sequential_reports = reports;
+            sequential_ms = sweep_ms;
+        }
+        bool match = (reports == sequential_reports);
+        all_match = all_match && match;
+        printf("%-16s specs=%d threads=%d sim_ms=%.3lf speedup=%.2lf same_as_1_thread=%s\n", "SWEEP", (int) specs.size(), num_threads, sweep_ms, sequential_ms/sweep_ms, match ? "OK" : "DIFF");
+        fflush(stdout);
+        if (num_threads >= max_threads) {
+            break;
+        }
+    }
+    return all_match;
+}
+
+// -------------------------------------------------------------------------------------------------------------- //
+
+// read each line of input file and create process objects
+bool load_processes(const char* path, vector<ProcessAccounting>& workload) {
+    MappedFile input_file;
+    if (!input_file.open(path)) {
+        cerr << "Error: failed to open input file " << path << endl;
+        return false;
+    }
+    const char* p = input_file.data;
+    const char* end = p + input_file.size;
+
+    // one process per line
+    workload.reserve(count(p, end, '\n') + 1);
+
+    int pid = 0;
+    while (p < end) {
+        const char* line_end = (const char*) memchr(p, '\n', end - p);
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+        workload.push_back(ProcessAccounting());
+        if (!parse_process_line(p, line_end, workload.back())) {
+            cerr << "Error input file format line " << pid << endl;
+            return false;
+        }
+        pid++;
+        // anything else on the line is ignored
+        p = line_end + 1;
+    }
+    return true;
+}
+
+// read first integer in random file as size of list, then the random numbers themselves
+bool load_random_numbers(const char* path) {
+    MappedFile rand_file;
+    if (!rand_file.open(path)) {
+        cerr << "Error: failed to open rfile " << path << endl;
+        return false;
+    }
+    const char* p = rand_file.data;
+    const char* end = p + rand_file.size;
+
+    num_random_numbers = 0;
+    if (!parse_int(p, end, num_random_numbers)) {
+        return true;
+    }
+    if (num_random_numbers > 0) {
+        randvals.reserve(num_random_numbers);
+    }
+
+    // read remaining random numbers
+    int integer;
+    while (parse_int(p, end, integer)) {
+        randvals.push_back(integer);
+    }
+    return true;
+}
+
+// read phase scripts: one line per programmed process, "pid repeat phase..." where a phase is c<time> (cpu burst),
+// i<time> (io wait) or s<time> (sleep); # starts a comment line
+bool load_phase_scripts(const char* path, int num_processes) {
+    ifstream input(path);
+    if (!input) {
+        cerr << "Error: failed to open phase file " << path << endl;
+        return false;
+    }
+    vector<bool> scripted(num_processes, false);
+    string line;
+    int line_number = 0;
+    while (getline(input, line)) {
+        line_number++;
+        istringstream fields(line);
+        PhaseScript script;
+        if (!(fields >> script.pid)) {
+            // blank or comment line
+            continue;
+        }
+        bool valid = (fields >> script.repeat) && (script.pid >= 0) && (script.pid < num_processes) && !scripted[script.pid] && (script.repeat > 0);
+        string phase;
+        while (valid && (fields >> phase)) {
+            Request request;
+            switch (phase[0]) {
+                case 'c':
+                    request.kind = REQ_CPU;
+                    break;
+                case 'i':
+                    request.kind = REQ_IO;
+                    break;
+                case 's':
+                    request.kind = REQ_SLEEP;
+                    break;
+                default:
+                    valid = false;
+                    break;
+            }
+            char* end;
+            request.time = strtol(phase.c_str() + 1, &end, 10);
+            valid = valid && (phase.size() > 1) && (*end == '\0') && (request.time >= 0);
+            script.phases.push_back(request);
+        }
+        if (!valid || script.phases.empty()) {
+            cerr << "Error phase file format line " << line_number << endl;
+            return false;
+        }
+        scripted[script.pid] = true;
+        phase_scripts.push_back(script);
+    }
+    return true;
+}
+
+// parameters of a synthetic workload: number of processes, mean interarrival time, mean total cpu time, mean
+// maximum cpu and io bursts, distribution of every draw (E exponential, which makes arrivals poisson, or U uniform
+// over [0, 2*mean]) and seed
+struct WorkloadSpec {
+    long count = 1000;
+    int interarrival = 10;
+    int total_cpu = 200;
+    int cpu_burst = 20;
+    int io_burst = 20;
+    char dist = 'E';
+    unsigned int seed = 1;
+};
+
+// parse -w count[:interarrival[:cpu[:cpu_burst[:io_burst[:dist[:seed]]]]]]
+bool parse_workload_spec(const char* arg, WorkloadSpec& spec) {
+    sscanf(arg, "%ld:%d:%d:%d:%d:%c:%u", &spec.count, &spec.interarrival, &spec.total_cpu, &spec.cpu_burst, &spec.io_burst, &spec.dist, &spec.seed);
+    return (spec.count > 0) && (spec.interarrival >= 0) && (spec.total_cpu > 0) && (spec.cpu_burst > 0) && (spec.io_burst > 0) && ((spec.dist == 'E') || (spec.dist == 'U'));
+}
+
+// draw a time with the given mean, at least minimum
+int draw_time(mt19937& generator, char dist, int mean, int minimum) {
+    double value;
+    if (dist == 'U') {
+        value = uniform_real_distribution<double>(0.0, 2.0*mean)(generator);
+    } else {
+        value = exponential_distribution<double>(1.0/mean)(generator);
+    }
+    return max(minimum, (int) lround(value));
+}
+
+// write a synthetic workload in the input file format to stdout
+void generate_workload(const WorkloadSpec& spec) {
+    mt19937 generator(spec.seed);
+    long arrival_time = 0;
+    for (long i = 0; i < spec.count; i++) {
+        if ((i > 0) && (spec.interarrival > 0)) {
+            arrival_time = arrival_time + draw_time(generator, spec.dist, spec.interarrival, 0);
+        }
+        int total_cpu_time = draw_time(generator, spec.dist, spec.total_cpu, 1);
+        int max_cpu_burst = draw_time(generator, spec.dist, spec.cpu_burst, 1);
+        int max_io_burst = draw_time(generator, spec.dist, spec.io_burst, 1);
+        printf("%ld %d %d %d\n", arrival_time, total_cpu_time, max_cpu_burst, max_io_burst);
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+
+    bool verbose = false;
+    bool benchmark = false;
+    bool specialized = true;
+    bool summary_only = false;
+    char golden_engine = 0; // benchmark mode when set
+    char* checkpoint_path = nullptr;
+    int checkpoint_time = 0;
+    char* restore_path = nullptr;
+    char* phase_path = nullptr;
+    char* trace_path = nullptr;
+    SchedulerSpec spec;
+    MachineSpec machine;
+    vector<SchedulerSpec> sweep_specs;
+    int num_threads = thread::hardware_concurrency();
+    int c;
+    // read flags
+    while ((c = getopt (argc, argv, "vbgqs:e:c:S:j:t:d:w:B:C:R:p:i:r:x:f:")) != -1) {
+        switch (c) {
+            case 'v':
                 // enable verbose output
                 verbose = true;
                 break;
+            case 'b':
+                // enable benchmark statistics
+                benchmark = true;
+                break;
+            case 'g':
+                // use the generic virtual dispatch simulation loop
+                specialized = false;
+                break;
+            case 'q':
+                summary_only = true;
+                break;
             case 's':
                 // scheduler specified
-                got_s = true;
-                scheduler_symbol = optarg[0];
-                // use specified scheduler
-                switch (scheduler_symbol) {
-                    case 'F':
-                        scheduler = new FCFS();
-                        scheduler_name = "FCFS";
-                        break;
-                    case 'L':
-                        scheduler = new LCFS();
-                        scheduler_name = "LCFS";
-                        break;
-                    case 'S':
-                        scheduler = new SRTF();
-                        scheduler_name = "SRTF";
-                        break;
-                    case 'R':
-                        // extract quantum and max priority
-                        sscanf(optarg + 1, "%d:%d", &quantum, &max_prio);
-                        scheduler = new RR(quantum);
-                        scheduler_name = "RR " + to_string(quantum);
-                        // overwrite max priority to 4
-                        max_prio = 4;
-                        break;
-                    case 'P':
-                        // extract quantum and max priority
-                        sscanf(optarg + 1, "%d:%d", &quantum, &max_prio);
-                        scheduler = new PRIO(quantum);
-                        scheduler_name = "PRIO " + to_string(quantum);
-                        break;
-                    case 'E':
-                        // extract quantum and max priority
-                        sscanf(optarg + 1, "%d:%d", &quantum, &max_prio);
-                        scheduler = new PREPRIO(quantum);
-                        scheduler_name = "PREPRIO " + to_string(quantum);
-                        break;
-                    default:
-                        // return error message on unknown value
-                        cout << "Unknown Scheduler spec: -s {FLSRPE}" << endl;
+                if (!parse_scheduler_spec(optarg, spec)) {
+                    // return error message on unknown value
+                    cout << "Unknown Scheduler spec: -s {FLSRPECTDXMQ}" << endl;
+                    return 1;
+                }
+                break;
+            case 'e':
+                // event queue engine specified
+                machine.engine = optarg[0];
+                if ((machine.engine != 'L') && (machine.engine != 'H')) {
+                    // return error message on unknown value
+                    cout << "Unknown Event queue spec: -e {LH}" << endl;
+                    return 1;
+                }
+                break;
+            case 'c':
+                // extract number of cpus, migration cost and cache affinity window
+                sscanf(optarg, "%d:%d:%d", &machine.num_cpus, &machine.migration_cost, &machine.cache_affinity);
+                if (machine.num_cpus < 1) {
+                    cout << "Invalid number of cpus: -c N[:migration_cost[:affinity]]" << endl;
+                    return 1;
+                }
+                break;
+            case 'x':
+                // extract context switch cost, cache refill time and cache window
+                sscanf(optarg, "%d:%d:%d", &machine.switch_cost, &machine.cache_refill, &machine.cache_window);
+                if ((machine.switch_cost < 0) || (machine.cache_refill < 0) || (machine.cache_window < 1)) {
+                    cout << "Invalid switch cost: -x switch_cost[:cache_refill[:cache_window]]" << endl;
+                    return 1;
+                }
+                break;
+            case 'f':
+                // extract dvfs frequency states, governor and idle power
+                if (!parse_frequency_spec(optarg, machine)) {
+                    cout << "Invalid frequency states: -f freq@power[,freq@power...][:{PWOU}[:idle_power]]" << endl;
+                    return 1;
+                }
+                break;
+            case 'i':
+                // extract number of io devices, service discipline, tracks and seek speed
+                sscanf(optarg, "%d:%c:%d:%d", &machine.num_devices, &machine.io_discipline, &machine.io_tracks, &machine.seek_speed);
+                if ((machine.num_devices < 1) || !strchr("FSL", machine.io_discipline) || (machine.io_tracks < 1) || (machine.seek_speed < 1)) {
+                    cout << "Invalid io devices: -i N[:{FSL}[:tracks[:seek_speed]]]" << endl;
+                    return 1;
+                }
+                break;
+            case 'S': {
+                // comma separated list of scheduler specs to sweep over
+                string list_arg = optarg;
+                size_t start = 0;
+                while (start <= list_arg.size()) {
+                    size_t end = list_arg.find(',', start);
+                    if (end == string::npos) {
+                        end = list_arg.size();
+                    }
+                    SchedulerSpec sweep_spec;
+                    if ((end == start) || !parse_scheduler_spec(list_arg.substr(start, end - start).c_str(), sweep_spec)) {
+                        cout << "Unknown Scheduler spec in sweep: -S spec[,spec...]" << endl;
                         return 1;
+                    }
+                    sweep_specs.push_back(sweep_spec);
+                    start = end + 1;
+                }
+                break;
+            }
+            case 'j':
+                // number of threads for a sweep
+                sscanf(optarg, "%d", &num_threads);
+                break;
+            case 't':
+                // write binary trace to file
+                trace_path = optarg;
+                break;
+            case 'd':
+                // decode binary trace file to verbose text, no simulation
+                return decode_trace(optarg) ? 0 : 1;
+            case 'w': {
+                // generate a synthetic workload, no simulation
+                WorkloadSpec workload_spec;
+                if (!parse_workload_spec(optarg, workload_spec)) {
+                    cout << "Invalid workload spec: -w count[:interarrival[:cpu[:cpu_burst[:io_burst[:{EU}[:seed]]]]]]" << endl;
+                    return 1;
+                }
+                generate_workload(workload_spec);
+                return 0;
+            }
+            case 'C': {
+                // write a checkpoint when simulated time reaches the given time
+                char* separator = strchr(optarg, ':');
+                if ((separator == nullptr) || (sscanf(optarg, "%d", &checkpoint_time) != 1)) {
+                    cout << "Invalid checkpoint spec: -C time:file" << endl;
+                    return 1;
+                }
+                checkpoint_path = separator + 1;
+                break;
+            }
+            case 'R':
+                // start from a checkpoint instead of time 0
+                restore_path = optarg;
+                break;
+            case 'r':
+                // built-in random number generator, no random file
+                builtin_random = true;
+                random_seed = strtoull(optarg, nullptr, 0);
+                break;
+            case 'p':
+                // programmed process behavior
+#ifdef SCHED_COROUTINES
+                phase_path = optarg;
+                break;
+#else
+                cout << "Phase scripts need a C++20 build: -p phasefile" << endl;
+                return 1;
+#endif
+            case 'B':
+                // benchmark against a golden run on the given engine
+                golden_engine = optarg[0];
+                if ((golden_engine != 'L') && (golden_engine != 'H')) {
+                    cout << "Unknown Event queue spec: -B {LH}" << endl;
+                    return 1;
                 }
                 break;
             case '?':
                 // return error message on unknown flag
-                cout << "Usage: ./sched [-v] [-s sched] input randomfile" << endl;
+                cout << "Usage: ./sched [-v] [-b] [-g] [-q] [-t tracefile] [-C time:file] [-R file] [-p phasefile] [-s sched] [-e engine] [-c cpus] [-x switch_cost] [-f freq@power,...] [-i devices] [-S sched,... [-j threads]] input {randomfile | -r seed}" << endl;
+                cout << "       ./sched -B golden_engine [-e engine] [-c cpus] [-S sched,...] [-j threads] input {randomfile | -r seed}" << endl;
+                cout << "       ./sched -d tracefile" << endl;
+                cout << "       ./sched -w count[:interarrival[:cpu[:cpu_burst[:io_burst[:dist[:seed]]]]]] > input" << endl;
                 cout << "   -v enables verbose" << endl;
+                cout << "   -b prints benchmark statistics to stderr" << endl;
+                cout << "   -g uses the generic virtual dispatch simulation loop instead of the per scheduler one" << endl;
+                cout << "   -q prints only aggregate metrics, turnaround and waiting time percentiles and the weighted fairness index;" << endl;
+                cout << "      without -v, -t, -C, -R, -p, -S or -sT the input is read as the simulation reaches each arrival" << endl;
+                cout << "      and finished processes give up their slots, so memory follows the processes alive at once" << endl;
+                cout << "   -t writes a binary trace of every transition to tracefile" << endl;
+                cout << "   -d decodes a binary trace into verbose output" << endl;
+                cout << "   -C writes a checkpoint of the simulation to file once simulated time reaches time" << endl;
+                cout << "   -R resumes from a checkpoint of the same input, with the same or another scheduler (priorities beyond its maxprio are clamped)" << endl;
+                cout << "   -p replays per process phase scripts (pid repeat c<cpu> i<io> s<sleep> ...) instead of random bursts" << endl;
+                cout << "   -r draws random numbers from a generator seeded with seed instead of reading a random file" << endl;
                 cout << "   -s specifies scheduler and params" << endl;
+                cout << "   -e specifies event queue engine: L (sorted list, default) or H (heap)" << endl;
+                cout << "   -c specifies number of cpus, migration cost and cache affinity window" << endl;
+                cout << "   -x charges a context switch cost per dispatch of another process, plus up to cache_refill to warm the" << endl;
+                cout << "      caches again, growing with the time the process was off the cpu up to cache_window" << endl;
+                cout << "   -f runs the cpus at dvfs frequency states picked by a governor: P (performance), W (powersave)," << endl;
+                cout << "      O (ondemand) or U (schedutil, default); bursts slow down at lower frequencies" << endl;
+                cout << "   -i models N io devices with FIFO (F), SSTF (S) or LOOK (L) queues, tracks and seek speed" << endl;
+                cout << "   -S runs one simulation per listed scheduler spec and prints one result block each" << endl;
+                cout << "   -j specifies number of threads used by -S and -B" << endl;
+                cout << "   -B benchmarks every policy (or those given with -S) on engine -e and checks each report against" << endl;
+                cout << "      a run of the generic loop on golden_engine; use H for large workloads, L inserts in linear time;" << endl;
+                cout << "      with -j above 1 it also times the whole sweep on 1, 2, 4, ... threads" << endl;
+                cout << "   -w writes a synthetic workload with exponential (E, default) or uniform (U) times to stdout" << endl;
                 return 1;
             
         }
     }
-    // if no scheduler specified then use FCFS
-    if (!got_s) {
-        scheduler = new FCFS();
-        scheduler_name = "FCFS";
+    if (num_threads < 1) {
+        num_threads = 1;
     }
     
-    // open input file
-    ifstream input_file(argv[optind]);
-    if (!input_file) {
-        cerr << "Error: failed to open input file " << argv[optind] << endl;
+    // load workload and random numbers
+    chrono::steady_clock::time_point load_start = chrono::steady_clock::now();
+    // a summary run of one simulation streams its input, unless a feature needs the rows of every process or
+    // lottery's ticket tree, which is laid out by pid
+    bool streamed = summary_only && (golden_engine == 0) && sweep_specs.empty() && !verbose && (trace_path == nullptr) && (checkpoint_path == nullptr) && (restore_path == nullptr) && (phase_path == nullptr) && (spec.symbol != 'T');
+    vector<ProcessAccounting> workload;
+    if ((!streamed && !load_processes(argv[optind], workload)) || (!builtin_random && !load_random_numbers(argv[optind+1]))) {
         return 1;
     }
-
-    string line;
-    int pid = 0;
-    // read each line of input file and create process objects
-    while (getline(input_file, line)) {
-        stringstream ss(line);
-        int arrival_time, total_cpu_time, max_cpu_burst, max_io_burst;
-        if (ss >> ws >> arrival_time >> ws >> total_cpu_time >> ws >> max_cpu_burst >> ws >> max_io_burst) {
-            Process process = Process(pid, arrival_time, total_cpu_time, max_cpu_burst, max_io_burst);
-            processes.push_back(process);
-            pid++;
-        } else {
-            cerr << "Error input file format line " << pid << endl;
+    // device queues are not part of a checkpoint
+    if ((machine.num_devices > 0) && ((checkpoint_path != nullptr) || (restore_path != nullptr))) {
+        cerr << "Error: io devices can't be combined with checkpoints" << endl;
+        return 1;
+    }
+    if (phase_path != nullptr) {
+        // suspended coroutines are not part of a checkpoint
+        if ((checkpoint_path != nullptr) || (restore_path != nullptr)) {
+            cerr << "Error: phase scripts can't be combined with checkpoints" << endl;
+            return 1;
+        }
+        if (!load_phase_scripts(phase_path, workload.size())) {
             return 1;
         }
     }
+    chrono::steady_clock::time_point load_end = chrono::steady_clock::now();
 
-    // open random numbers file
-    ifstream rand_file(argv[optind+1]);
-    if (!rand_file) {
-        cerr << "Error: failed to open rfile " << argv[optind+1] << endl;
-        return 1;
+    // benchmark: one line per scheduler spec, exit status reports whether all matched the golden runs
+    if (golden_engine != 0) {
+        if (sweep_specs.empty()) {
+            const char* bench_specs[] = {"F", "L", "S", "R10", "P10", "E10", "C", "T10", "D10", "X", "M", "Q10"};
+            for (const char* bench_spec : bench_specs) {
+                SchedulerSpec sweep_spec;
+                parse_scheduler_spec(bench_spec, sweep_spec);
+                sweep_specs.push_back(sweep_spec);
+            }
+        }
+        bool all_match = run_benchmark(sweep_specs, machine, golden_engine, workload);
+        // speedup of the sweep with threads, when more than one is available
+        if (num_threads > 1) {
+            all_match = run_sweep_benchmark(sweep_specs, machine, workload, num_threads) && all_match;
+        }
+        return all_match ? 0 : 1;
     }
 
-    // read first integer in file as size of list
-    rand_file >> num_random_numbers;
-
-    // read remaining random numbers
-    int integer;
-    while (rand_file >> integer) {
-        randvals.push_back(integer);
+    // sweep: print one result block per scheduler spec, in the order given
+    if (!sweep_specs.empty()) {
+        vector<string> reports = run_sweep(sweep_specs, machine, workload, num_threads, summary_only);
+        for (int i = 0; i < (int) reports.size(); i++) {
+            fputs(reports[i].c_str(), stdout);
+        }
+        return 0;
     }
-    
-    // set static priorities  for processes
-    for (int i = 0; i < processes.size(); i++) {
-        processes[i].static_prio = myrandom(max_prio);
-        processes[i].pid = i;
-        // create arrival events
-        des.add_Event(Event(processes[i].arrival_time, &processes[i], CREATED, READY));
+
+    SimulationContext context(spec, machine);
+    context.summary_only = summary_only;
+    if (restore_path != nullptr) {
+        if (!context.restore_checkpoint(restore_path, workload)) {
+            return 1;
+        }
+    } else if (!streamed || !context.stream(argv[optind])) {
+        // input that can't be streamed is loaded after all, reporting its errors
+        if (streamed && !load_processes(argv[optind], workload)) {
+            return 1;
+        }
+        context.load(workload);
     }
+    context.checkpoint_path = checkpoint_path;
+    context.checkpoint_time = checkpoint_time;
 
-    // run simulation, catch finishing time of last process
-    int final_time = Simulation();
+    // open traces
+    FILE* trace_file = nullptr;
+    if (verbose) {
+        context.text_trace = new TraceWriter(stdout, false);
+    }
+    if (trace_path != nullptr) {
+        trace_file = fopen(trace_path, "wb");
+        if (trace_file == nullptr) {
+            cerr << "Error: failed to open trace file " << trace_path << endl;
+            return 1;
+        }
+        context.binary_trace = new TraceWriter(trace_file, true);
+    }
 
-    // calculate simulation metrics and generate output
-    int total_cpubusy = 0;
-    int total_turnaround = 0;
-    int total_cpu_waiting = 0;
+    // run simulation
+    long allocations_before = num_allocations;
+    chrono::steady_clock::time_point sim_start = chrono::steady_clock::now();
+    context.run(specialized);
+    chrono::steady_clock::time_point sim_end = chrono::steady_clock::now();
+    long sim_allocations = num_allocations - allocations_before;
 
-    cout << scheduler_name << endl;
-    for (const auto process : processes) {
-        // print process metrics
-        printf("%04d: %4d %4d %4d %4d %1d | %5d %5d %5d %5d\n", process.pid, process.arrival_time, process.total_cpu_time, process.max_cpu_burst, process.max_io_burst, process.static_prio, process.finishing_time, process.turnaround_time, process.total_io_time, process.cpu_waiting_time);
-        total_cpubusy = total_cpubusy + process.total_cpu_time;
-        total_turnaround = total_turnaround + process.turnaround_time;
-        total_cpu_waiting = total_cpu_waiting + process.cpu_waiting_time;
+    // write out remaining trace before the report
+    delete context.text_trace;
+    delete context.binary_trace;
+    context.text_trace = nullptr;
+    context.binary_trace = nullptr;
+    if (trace_file != nullptr) {
+        fclose(trace_file);
     }
 
-    double cpu_util = 100.0*(total_cpubusy/(double) final_time);
-    double io_util = 100.0*(total_IO_time/(double) final_time);
-    double throughput = 100.0*(processes.size()/(double) final_time);
-    double avg_turnaround = ((double) total_turnaround)/((double) processes.size());
-    double avg_cpu_waiting = ((double) total_cpu_waiting)/((double) processes.size());
+    fputs(context.report().c_str(), stdout);
+    STATS(fputs(context.stats_json().c_str(), stderr));
 
-    // print aggregate metrics
-    printf("SUM: %d %.2lf %.2lf %.2lf %.2lf %.3lf\n", final_time, cpu_util, io_util, avg_turnaround, avg_cpu_waiting, throughput);
+    // print benchmark statistics: simulation wall time and heap allocations made inside the event loop
+    if (benchmark) {
+        double sim_ms = chrono::duration<double, milli>(sim_end - sim_start).count();
+        double load_ms = chrono::duration<double, milli>(load_end - load_start).count();
+        fprintf(stderr, "BENCH: loop=%s load_ms=%.3lf events=%ld sim_ms=%.3lf ns_per_event=%.1lf allocs=%ld\n", specialized ? "specialized" : "virtual", load_ms, context.num_events, sim_ms, (context.num_events > 0) ? 1e6*sim_ms/context.num_events : 0.0, sim_allocations);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
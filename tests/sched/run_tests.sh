@@ -0,0 +1,67 @@
+#!/bin/bash
+# regression tests for sched: every case is run on both event queue engines and its output compared byte for byte
+# with the golden output in expected/, which was produced by the original single engine simulator (checkpoint cases
+# by a checked build)
+#
+# usage: tests/sched/run_tests.sh [sched_binary]     (default ./sched)
+
+SCHED=$(realpath "${1:-./sched}")
+DIR=$(dirname "$(realpath "$0")")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+cd "$DIR" || exit 1
+
+# name|arguments before input and random file|input
+CASES=(
+    "rr5_v|-v -sR5|input0"
+    "preprio2_v|-v -sE2|input0"
+    "preprio5_3_v|-v -sE5:3|input0"
+    "preprio3_40_v|-v -sE3:40|input0"
+    "fcfs|-sF|input2"
+    "rr5|-sR5|input2"
+    "prio5_3|-sP5:3|input2"
+    "preprio2|-sE2|input2"
+    "preprio5_3|-sE5:3|input2"
+    "preprio10_8|-sE10:8|input2"
+    "preprio3_40|-sE3:40|input2"
+)
+
+# name|scheduler writing the checkpoint|scheduler restoring it|input
+CHECKPOINTS=(
+    "ckpt_rr5_to_preprio4_2|-sR5|-sE4:2|input1"
+    "ckpt_preprio4_8_to_preprio4_2|-sE4:8|-sE4:2|input1"
+    "ckpt_preprio4_2_to_preprio4_8|-sE4:2|-sE4:8|input1"
+)
+
+failed=0
+check() {
+    local name=$1 engine=$2 status=$3
+    if [ "$status" -ne 0 ]; then
+        echo "FAIL $name -e$engine: exit status $status"
+        failed=1
+    elif ! diff -q "expected/$name.out" "$TMP/out" > /dev/null; then
+        echo "FAIL $name -e$engine: output differs"
+        diff "expected/$name.out" "$TMP/out" | head -10
+        failed=1
+    fi
+}
+
+for engine in L H; do
+    for entry in "${CASES[@]}"; do
+        IFS='|' read -r name args input <<< "$entry"
+        "$SCHED" -e$engine $args $input rfile > "$TMP/out"
+        check $name $engine $?
+    done
+    for entry in "${CHECKPOINTS[@]}"; do
+        IFS='|' read -r name from to input <<< "$entry"
+        "$SCHED" -e$engine $from -C "1500:$TMP/ckpt" $input rfile > /dev/null &&
+            "$SCHED" -e$engine $to -R "$TMP/ckpt" $input rfile > "$TMP/out"
+        check $name $engine $?
+    done
+done
+
+if [ $failed -ne 0 ]; then
+    echo "FAILED"
+    exit 1
+fi
+echo "all $(( 2*(${#CASES[@]} + ${#CHECKPOINTS[@]}) )) tests passed"